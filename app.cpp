@@ -4,19 +4,35 @@
 #include "io.hpp"
 #include "keyboard.hpp"
 #include "parser.hpp"
+#include "unicode.hpp"
 
 #include <SDL.h>
 #include <chrono>
+#include <condition_variable>
 #include <iomanip>
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <optional>
 #include <sstream>
 #include <string.h>
+#include <thread>
 
 constexpr int user_event_code_stat = 123;
-constexpr int user_event_child_data = 124;
+constexpr int user_event_child_exit = 124;
+constexpr int user_event_snapshot = 125;
+constexpr int user_event_set_title = 126;
+constexpr int user_event_set_clipboard = 127;
 
 namespace {
+// The line drawing and symbols of DEC special graphics, for 0x5F to 0x7E.
+constexpr uint32_t dec_special_graphics[32] = {
+    0x00A0, 0x25C6, 0x2592, 0x2409, 0x240C, 0x240D, 0x240A, 0x00B0,
+    0x00B1, 0x2424, 0x240B, 0x2518, 0x2510, 0x250C, 0x2514, 0x253C,
+    0x23BA, 0x23BB, 0x2500, 0x23BC, 0x23BD, 0x251C, 0x2524, 0x2534,
+    0x252C, 0x2502, 0x2264, 0x2265, 0x03C0, 0x2260, 0x00A3, 0x00B7,
+};
+
 Uint32 stat_callback(Uint32 interval, void *) {
   std::cout << "Timer callback called\n";
   SDL_Event event;
@@ -33,16 +49,136 @@ Uint32 stat_callback(Uint32 interval, void *) {
   SDL_PushEvent(&event);
   return interval;
 }
+
+void push_event(int code, void *data = nullptr) {
+  SDL_Event event;
+  SDL_memset(&event, 0, sizeof(event));
+  event.type = SDL_USEREVENT;
+  event.user.code = code;
+  event.user.data1 = data;
+
+  SDL_PushEvent(&event);
+}
+
+void push_string_event(int code, std::string text) {
+  // The render loop takes ownership of the string.
+  push_event(code, new std::string{std::move(text)});
+}
+
+struct Mailbox {
+  // Work for the parser thread, from the pty and the render loop. Only
+  // held while posting or collecting work, never while it is done.
+  std::mutex mutex;
+  std::condition_variable cv;
+
+  // Child output, valid until read_complete is called.
+  const char *data = nullptr;
+  size_t length = 0;
+  bool data_ready = false;
+  bool child_exited = false;
+
+  bool frame_done = false;
+  std::optional<std::pair<int, int>> size;
+  bool quit = false;
+
+  template <typename F> void post(F &&f) {
+    {
+      std::lock_guard<std::mutex> lock{mutex};
+      f();
+    }
+    cv.notify_one();
+  }
+};
+
+void parse_loop(app::App &term, io::PseudoTerminal &pt, Mailbox &mailbox) {
+  while (true) {
+    std::unique_lock<std::mutex> lock{mailbox.mutex};
+    mailbox.cv.wait(lock, [&] {
+      return mailbox.data_ready || mailbox.child_exited ||
+             mailbox.frame_done || mailbox.size || mailbox.quit;
+    });
+
+    if (mailbox.quit) {
+      return;
+    }
+
+    if (mailbox.child_exited) {
+      push_event(user_event_child_exit);
+      return;
+    }
+
+    const char *data = mailbox.data;
+    size_t length = mailbox.data_ready ? mailbox.length : 0u;
+    bool frame_done = std::exchange(mailbox.frame_done, false);
+    auto size = std::exchange(mailbox.size, std::nullopt);
+    mailbox.data_ready = false;
+
+    lock.unlock();
+
+    if (size) {
+      term.resize(size->first, size->second);
+      pt.set_size(size->first, size->second);
+      std::cout << "Resizing terminal to (" << size->first << "x "
+                << size->second << ") after window sizechange" << std::endl;
+      term.grid_changed();
+    }
+
+    if (data != nullptr && length != 0u) {
+      term.parse_input(data, length);
+      // The parser holds back the end of each chunk in case the next one
+      // extends it. If nothing more is waiting, show it now.
+      if (!pt.input_pending()) {
+        term.flush_text();
+      }
+      pt.read_complete();
+      term.grid_changed();
+    }
+
+    if (frame_done) {
+      term.frame_done();
+    }
+  }
+}
 } // namespace
 
 namespace app {
 
+void App::publish() {
+  gfx::Snapshot &snapshot = snapshots.back_buffer();
+  grid.snapshot(snapshot);
+
+  snapshots.publish();
+  unpublished = false;
+
+  push_event(user_event_snapshot);
+}
+
+void App::grid_changed() {
+  if (snapshots.consumed()) {
+    publish();
+  } else {
+    unpublished = true;
+  }
+}
+
+void App::frame_done() {
+  if (unpublished && snapshots.consumed()) {
+    publish();
+  }
+}
+
 void App::on_glyph(const char *data, size_t length) {
+  char utf8[4];
+  if (dec_graphics && length == 1u && data[0] >= 0x5F && data[0] <= 0x7E) {
+    length = unicode::encode_utf8(dec_special_graphics[data[0] - 0x5F], utf8);
+    data = utf8;
+  }
+
   putglyph(data, length);
-  window.move_cursor(row, col);
+  grid.move_cursor(row, col);
 
 #ifdef PEACHTERM_IS_SLOMO
-  window.redraw();
+  publish();
   SDL_Delay(10);
 #endif
 
@@ -52,12 +188,39 @@ void App::on_glyph(const char *data, size_t length) {
 #endif
 }
 
+void App::on_text(const char *data, size_t length) {
+  if (dec_graphics) {
+    // Translated a glyph at a time, they're no longer single bytes.
+    BasicVTParser::on_text(data, length);
+    return;
+  }
+
+#ifdef PEACHTERM_IS_SLOMO
+  // Draw each character separately.
+  BasicVTParser::on_text(data, length);
+#else
+  put_text(data, length);
+  grid.move_cursor(row, col);
+#endif
+
+#ifdef PEACHTERM_IS_VERY_VERBOSE
+  std::string_view text{data, length};
+  std::cout << "Text: " << std::quoted(text) << "\n";
+#endif
+}
+
+void App::on_charset(char c) {
+  // Only ASCII and DEC special graphics are told apart, the national
+  // replacement sets are taken as ASCII.
+  dec_graphics = c == '0';
+}
+
 void App::on_backspace() {
 #ifdef PEACHTERM_IS_VERBOSE
   std::cout << "on_backspace\n";
 #endif
   curs_backspace();
-  window.move_cursor(row, col);
+  grid.move_cursor(row, col);
 }
 
 void App::on_newline() {
@@ -65,7 +228,7 @@ void App::on_newline() {
   std::cout << "on_newline\n";
 #endif
   curs_newline();
-  window.move_cursor(row, col);
+  grid.move_cursor(row, col);
 }
 
 void App::on_return() {
@@ -73,7 +236,7 @@ void App::on_return() {
   std::cout << "on_return\n";
 #endif
   curs_to_col(0);
-  window.move_cursor(row, col);
+  grid.move_cursor(row, col);
 }
 
 int tab_stop(int start, int num_stops) {
@@ -85,19 +248,19 @@ void App::on_tab() {
   std::cout << "on_tab\n";
 #endif
   curs_to_col(tab_stop(col, 1));
-  window.move_cursor(row, col);
+  grid.move_cursor(row, col);
 }
 
 void App::adjust_cursor(int rows_n, int cols_n) {
   curs_to_row(row + rows_n);
   curs_to_col(col + cols_n);
-  window.move_cursor(row, col);
+  grid.move_cursor(row, col);
 }
 
 void App::set_cursor(int n_row, int n_col) {
   curs_to_row(n_row);
   curs_to_col(n_col);
-  window.move_cursor(row, col);
+  grid.move_cursor(row, col);
 }
 
 void App::on_ri() {
@@ -119,13 +282,13 @@ void App::set_scroll_region(int start_row, int end_row) {
 void App::perform_el(int arg) {
   switch (arg) {
   case 0: // Erase to right.
-    window.clear_cells(row, col, cols);
+    grid.clear_cells(row, col, cols);
     return;
   case 1: // Erase to left.
-    window.clear_cells(row, 0, col);
+    grid.clear_cells(row, 0, col);
     return;
   case 2: // Erase all.
-    window.clear_cells(row, 0, cols);
+    grid.clear_cells(row, 0, cols);
     return;
   }
 }
@@ -137,13 +300,13 @@ void App::perform_ed(bool selective, int arg) {
 
   switch (arg) {
   case 0: // Erase below
-    window.clear_rows(row + 1, rows);
+    grid.clear_rows(row + 1, rows);
     break;
   case 1: // Erase above
-    window.clear_rows(0, row);
+    grid.clear_rows(0, row);
     break;
   case 2: // Erase all
-    window.clear_rows(0, rows);
+    grid.clear_rows(0, rows);
     break;
   case 3: // Erase saved lines
   default:
@@ -151,93 +314,115 @@ void App::perform_ed(bool selective, int arg) {
   }
 }
 
-void App::csi_m(const std::vector<int> &args) {
+void App::csi_m(const parser::CSIParams &args) {
   // return;
-  using A = gfx::TermCell::Attr;
+  using A = gfx::Style::Attr;
 
-  auto parse_extended_colour = [&](auto &i) -> std::optional<uint32_t> {
-    ++i;
+  util::ScopeExit resolve_pen{[&] { pen_changed(); }};
 
-    if (i == args.end()) {
-      // BAD: not enough args
-      return {};
-    }
+  // An empty SGR is a reset.
+  const size_t count = args.empty() ? 1 : args.size();
 
-    // the first number indicates if we are in 256 color mode (one more number)
-    // or full color mode (three more numbers)
-    bool _256 = *i == 5;
+  auto arg_at = [&](size_t i) { return args.empty() ? 0 : args[i]; };
 
-    ++i;
-
-    if (i == args.end()) {
-      // BAD: not enough args
-      return {};
+  // One past the last sub-parameter (those separated by ':') of arg i.
+  auto sub_params_end = [&](size_t i) {
+    size_t end = i + 1;
+    while (end < count && args.is_sub_param(end)) {
+      ++end;
     }
+    return end;
+  };
 
-    if (_256) {
-      return colors::table[*i];
+  // Reads 5;n or 2;r;g;b following a 38 or 48, or the colon forms 5:n,
+  // 2:r:g:b and 2:<colour space>:r:g:b. Leaves i on the last arg used.
+  auto parse_extended_colour = [&](size_t &i) -> std::optional<uint32_t> {
+    size_t end = sub_params_end(i);
+    bool colon = end != i + 1;
+
+    if (!colon) {
+      end = count;
     }
 
-    // read out the R, G, B components (each treated as 8 bit numbers)
-    ++i;
+    size_t next = i + 1;
 
-    if (i == args.end()) {
-      // BAD: not enough args
-      return {};
-    }
+    auto take = [&]() -> std::optional<int> {
+      if (next == end) {
+        // BAD: not enough args
+        return {};
+      }
+      return args[next++];
+    };
 
-    uint32_t colour = 0xFF & *i;
-    colour <<= 8;
+    // the first number indicates if we are in 256 color mode (one more number)
+    // or full color mode (three more numbers)
+    auto mode = take();
 
-    ++i;
+    if (mode == 5) {
+      auto index = take();
+      if (!index || *index > 255) {
+        return {};
+      }
+      i = colon ? end - 1 : next - 1;
+      return colors::table[*index];
+    }
 
-    if (i == args.end()) {
-      // BAD: not enough args
+    if (mode != 2) {
       return {};
     }
 
-    colour |= 0xFF & *i;
-    colour <<= 8;
+    if (colon && end - next == 4) {
+      // skip the colour space id.
+      ++next;
+    }
 
-    ++i;
+    // read out the R, G, B components (each treated as 8 bit numbers)
+    auto r = take();
+    auto g = take();
+    auto b = take();
 
-    if (i == args.end()) {
-      // BAD: not enough args
+    if (!r || !g || !b) {
       return {};
     }
 
-    colour |= 0xFF & *i;
-    colour <<= 8;
+    i = colon ? end - 1 : next - 1;
 
+    uint32_t colour = 0xFF & *r;
+    colour <<= 8;
+    colour |= 0xFF & *g;
+    colour <<= 8;
+    colour |= 0xFF & *b;
+    colour <<= 8;
     colour |= 0xFF;
 
     return colour;
   };
 
-  for (auto i = args.begin(); i != args.end(); ++i) {
-    int arg = *i;
+  for (size_t i = 0; i < count; ++i) {
+    int arg = arg_at(i);
 
     if (arg >= 90 && arg <= 107) {
       arg -= 60;
     }
 
     bool fg = arg >= 30 && arg < 40;
-    uint32_t &colour = fg ? cell.fg_col : cell.bg_col;
+    uint32_t &colour = fg ? pen.fg_col : pen.bg_col;
 
     std::optional<uint32_t> extended_colour;
 
     // clang-format off
           switch (arg) {
-          case 0:
-            cell_reset(A::BOLD, A::ITALIC, A::OVERLINE, A::UNDERLINE,
-                       A::DUNDERLINE, A::STRIKE, A::FEINT, A::REVERSE);
-            cell.fg_col = reset.fg_col;
-            cell.bg_col = reset.bg_col;
-                                                  break; // Reset all
+          case 0: pen = reset;                    break; // Reset all
           case 1: cell_set(A::BOLD);              break;
           case 2: cell_set(A::FEINT);             break;
           case 3: cell_set(A::ITALIC);            break;
-          case 4: cell_set(A::UNDERLINE);         break;
+          case 4:
+            // 4:0 is no underline, 4:n are underline styles.
+            if (sub_params_end(i) > i + 1 && args[i + 1] == 0)
+              cell_reset(A::UNDERLINE);
+            else
+              cell_set(A::UNDERLINE);
+                                                  break;
           case 7: cell_set(A::REVERSE);           break;
           case 9: cell_set(A::STRIKE);            break;
           case 21: cell_set(A::DUNDERLINE);       break;
@@ -269,7 +454,7 @@ void App::csi_m(const std::vector<int> &args) {
             extended_colour = parse_extended_colour(i);
             if(extended_colour) {
               colour = *extended_colour;
-              break;
+              continue;
             } else {
               return;
             }
@@ -279,6 +464,9 @@ void App::csi_m(const std::vector<int> &args) {
             break;
           }
     // clang-format on
+
+    // Skip sub-parameters which aren't otherwise understood.
+    i = sub_params_end(i) - 1;
   }
 }
 
@@ -296,16 +484,15 @@ void App::process_decrst(int arg, bool q) {
     case 47:
     case 1047:
     case 1049:
-      window.screen_mode_normal() = true;
+      grid.screen_mode_normal(true);
       printf("Normal screen buffer\n");
       break;
     }
     if (arg == 1047) {
-      window.clear_screen();
+      grid.clear_screen();
       printf("Clearing screen buffer\n");
     }
   }
-  window.dirty();
 }
 
 void App::process_decset(int arg, bool q) {
@@ -317,16 +504,15 @@ void App::process_decset(int arg, bool q) {
     case 47:
     case 1047:
     case 1049:
-      window.screen_mode_normal() = false;
+      grid.screen_mode_normal(false);
       printf("Alternate screen buffer\n");
     }
     if (arg == 1049) {
-      window.clear_screen();
+      grid.clear_screen();
       printf("Clearing screen buffer\n");
     }
   } else {
   }
-  window.dirty();
 }
 
 void App::process_status_report(int arg) {
@@ -341,13 +527,39 @@ void App::process_status_report(int arg) {
 
 void App::on_osi(int op, std::string_view data) {
   switch (op) {
-  case 0: {
-    window.set_window_title(data);
+  case 0:
+  case 2: {
+    push_string_event(user_event_set_title, std::string{data});
   } break;
   }
 }
 
-void App::on_csi(char operation, const std::vector<int> &args,
+void App::on_clipboard_begin(std::string_view selection) {
+  (void)selection;
+  clipboard.clear();
+  clipboard_overflow = false;
+}
+
+void App::on_clipboard_data(const char *data, size_t length) {
+  if (clipboard_overflow ||
+      clipboard.size() + length > max_clipboard_length) {
+    clipboard_overflow = true;
+    return;
+  }
+  clipboard.append(data, length);
+}
+
+void App::on_clipboard_end() {
+  // An empty or undecodable payload is a query, which is not answered.
+  if (!clipboard_overflow && !clipboard.empty()) {
+    push_string_event(user_event_set_clipboard, clipboard);
+  }
+  std::string{}.swap(clipboard);
+}
+
+void App::on_clipboard_abort() { std::string{}.swap(clipboard); }
+
+void App::on_csi(char operation, const parser::CSIParams &args,
                  std::string_view options) {
   auto arg = [&](int a, int def = 0) {
     return ((int)args.size() > a) ? args[a] : def;
@@ -361,7 +573,7 @@ void App::on_csi(char operation, const std::vector<int> &args,
 
   // clang-format off
   switch (operation) {
-  case '@': window.insert_cells(row, col, arg(0, 1));    break;
+  case '@': grid.insert_cells(row, col, arg(0, 1));    break;
   case 'A': adjust_cursor(-ag1(0, 1), 0);                break;
   case 'B': adjust_cursor(ag1(0, 1), 0);                 break;
   case 'C': adjust_cursor(0, ag1(0, 1));                 break;
@@ -376,11 +588,11 @@ void App::on_csi(char operation, const std::vector<int> &args,
   case 'L': insert_lines(ag1(0,1));                      break;
   case 'M': delete_lines(ag1(0,1));                      break;
 
-  case 'P': window.delete_cells(row, col, ag1(0, 1));    break;
+  case 'P': grid.delete_cells(row, col, ag1(0, 1));    break;
   case 'S': scroll_up(ag1(0,1));                         break;
   case 'T': scroll_down(ag1(0,1));                       break;
 
-  case 'X': window.clear_cells(row, col, ag1(0,1));      break;
+  case 'X': grid.clear_cells(row, col, ag1(0,1));      break;
   case 'Z': // -----------------------------------------------;
 
   case 'c': process_di();                                break;
@@ -388,14 +600,14 @@ void App::on_csi(char operation, const std::vector<int> &args,
   case 'h': process_decset(arg(0,0),q);                  break;
   case 'l': process_decrst(arg(0,0),q);                  break;
   case 'n': process_status_report(arg(0));               break;
-  case 'm': if(args.empty()) csi_m({0}); else csi_m(args); break;
+  case 'm': csi_m(args);                                 break;
   case 'r': set_scroll_region(ag1(0,1), ag1(1, rows));   break;
   case 's': process_decset(arg(0,0),q);                  break;
   default: std::cout << "UNKNOWN CSI: " << operation << std::endl;   
   }
   // clang-format on
 
-  window.move_cursor(row, col);
+  grid.move_cursor(row, col);
 }
 
 void App::on_esc(char op) {
@@ -420,18 +632,21 @@ size_t strnlen_s(const char *s, size_t len) {
 }
 
 void run(const gfx::FontSpec &spec) {
-  SDL_Event data_available;
-  SDL_memset(&data_available, 0, sizeof(data_available));
-  data_available.type = SDL_USEREVENT;
-  data_available.user.code = user_event_child_data;
+  Mailbox mailbox;
 
   std::cout << "PT run\n";
 
-  io::PseudoTerminal pt([&data_available](io::PseudoTerminal *,
-                                          const char *data, size_t length) {
-    data_available.user.data1 = static_cast<void *>(const_cast<char *>(data));
-    data_available.user.data2 = reinterpret_cast<void *>(length);
-    SDL_PushEvent(&data_available);
+  io::PseudoTerminal pt([&mailbox](io::PseudoTerminal *, const char *data,
+                                   size_t length) {
+    mailbox.post([&] {
+      if (data == nullptr && length == 0u) {
+        mailbox.child_exited = true;
+        return;
+      }
+      mailbox.data = data;
+      mailbox.length = length;
+      mailbox.data_ready = true;
+    });
   });
 
   int rows = 45;
@@ -451,17 +666,29 @@ void run(const gfx::FontSpec &spec) {
 
   std::cout << "App run\n";
 
+  gfx::TermWin window{rows, cols};
+
+  window.load_fonts(spec);
+
   App term{rows, cols, &pt};
 
   auto hist = std::make_shared<TermHistory>();
 
-  term.window.set_scrollback(hist);
-
-  term.window.load_fonts(spec);
+  term.grid.set_scrollback(hist);
 
   term.resize(rows, cols);
   pt.set_size(rows, cols);
 
+  term.publish();
+
+  // From here on the grid belongs to the parser thread.
+  std::thread parser_thread{[&] { parse_loop(term, pt, mailbox); }};
+
+  util::ScopeExit stop_parser{[&] {
+    mailbox.post([&] { mailbox.quit = true; });
+    parser_thread.join();
+  }};
+
   SDL_Event e;
 
   // Set callback
@@ -477,7 +704,7 @@ void run(const gfx::FontSpec &spec) {
         case SDLK_ESCAPE:
           if (e.key.keysym.mod & SDLK_LSHIFT) {
             std::cout << "Dump state\n";
-            term.window.dump_state_callback();
+            window.dump_state_callback();
           } else {
             return;
           }
@@ -505,15 +732,13 @@ void run(const gfx::FontSpec &spec) {
       } break;
       case SDL_MOUSEBUTTONDOWN: {
         std::cout << "Clean redraw\n";
-        term.window.dirty();
-        term.window.redraw();
+        window.redraw();
       } break;
       case SDL_WINDOWEVENT: {
         switch (e.window.event) {
         case SDL_WINDOWEVENT_TAKE_FOCUS:
         case SDL_WINDOWEVENT_EXPOSED: {
-          term.window.dirty();
-          term.window.redraw();
+          window.redraw();
         } break;
         case SDL_WINDOWEVENT_SIZE_CHANGED: {
           int width = e.window.data1;
@@ -522,14 +747,13 @@ void run(const gfx::FontSpec &spec) {
           std::cout << "Window size changed: " << width << "x" << height
                     << std::endl;
 
-          term.window.dirty();
-          term.window.redraw();
+          window.redraw();
         } break;
         case SDL_WINDOWEVENT_RESIZED: {
           int width = e.window.data1;
           int height = e.window.data2;
 
-          auto cell_size = term.window.cell_size();
+          auto cell_size = window.cell_size();
           int new_cols = width / cell_size.first;
           int new_rows = height / cell_size.second;
 
@@ -537,10 +761,7 @@ void run(const gfx::FontSpec &spec) {
                     << std::endl;
 
           if (abs(new_rows - rows) + abs(new_cols - cols) > 1) {
-            term.resize(new_rows, new_cols);
-            pt.set_size(new_rows, new_cols);
-            std::cout << "Resizing terminal to (" << new_rows << "x "
-                      << new_cols << ") after window sizechange" << std::endl;
+            mailbox.post([&] { mailbox.size = {new_rows, new_cols}; });
           }
         } break;
         }
@@ -552,23 +773,27 @@ void run(const gfx::FontSpec &spec) {
         switch (e.user.code) {
         case user_event_code_stat: {
           std::cout << "Stat event\n";
-          term.window.stat_callback();
+          window.stat_callback();
         } break;
-        case user_event_child_data: {
-#ifdef PEACHTERM_IS_VERBOSE
-          std::cout << "SDL Child Data Event\n";
-#endif
-          const char *data = static_cast<const char *>(e.user.data1);
-          size_t len = reinterpret_cast<size_t>(e.user.data2);
-
-          if (data == nullptr && len == 0u) {
-            return;
+        case user_event_snapshot: {
+          if (term.snapshots.update()) {
+            window.redraw(term.snapshots.front_buffer());
           }
-
-          term.parse_input(data, len);
-          term.window.redraw();
-          pt.read_complete();
-          continue;
+          // Let the parser thread publish whatever it has done since.
+          mailbox.post([&] { mailbox.frame_done = true; });
+        } break;
+        case user_event_set_title: {
+          std::unique_ptr<std::string> title{
+              static_cast<std::string *>(e.user.data1)};
+          window.set_window_title(*title);
+        } break;
+        case user_event_set_clipboard: {
+          std::unique_ptr<std::string> text{
+              static_cast<std::string *>(e.user.data1)};
+          window.set_clipboard(*text);
+        } break;
+        case user_event_child_exit: {
+          return;
         }
 
         default: {
@@ -580,7 +805,11 @@ void run(const gfx::FontSpec &spec) {
       }
       } // event type switch
     }   // while poll event
-    SDL_Delay(10);
+
+    // Only sleep once there's no background work left.
+    if (!window.idle()) {
+      SDL_WaitEvent(nullptr);
+    }
   } // while true
 
   // TODO: this not reached, the above code 'returns' instead of exiting the
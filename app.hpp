@@ -5,26 +5,59 @@
 #include "vterm.hpp"
 #include "io.hpp"
 #include "keyboard.hpp"
+#include "util.hpp"
+
+#include <atomic>
 
 namespace app {
-class App : public parser::VTParser, public app::VTerm {
+class App : public parser::BasicVTParser<App>, public app::VTerm {
   io::PseudoTerminal *pt_p;
-  keyboard::Mode kMode{keyboard::Mode::Normal};
+  std::atomic<keyboard::Mode> kMode{keyboard::Mode::Normal};
+
+  // OSC 52 clipboard contents, as they are decoded.
+  std::string clipboard;
+  bool clipboard_overflow{false};
+
+  // The grid changed since the last snapshot was published.
+  bool unpublished{false};
+
+  // G0 is DEC special graphics, by ESC ( 0, rather than ASCII.
+  bool dec_graphics{false};
 
 public:
   App(int rows, int cols, io::PseudoTerminal *pt) : app::VTerm{rows, cols}, pt_p{pt} {}
 
-  // Implement parser::VTParser interface...
-  void on_glyph(const char *data, size_t length) override;
-  void on_backspace() override;
-  void on_newline() override;
-  void on_return() override;
-  void on_tab() override;
-  void on_csi(char operation, const std::vector<int> &args,
-              std::string_view /*options*/) override;
-  void on_ri() override;
-  void on_esc(char op) override;
-  void on_osi(int op, std::string_view) override;
+  // Snapshots of the grid, published by the parser thread and drawn by the
+  // render loop.
+  util::TripleBuffer<gfx::Snapshot> snapshots;
+
+  void publish();
+  // Snapshot the grid for the render loop, and wake it.
+  void grid_changed();
+  // Publish now if the last snapshot has been taken, otherwise leave it
+  // until it has.
+  void frame_done();
+  // The render loop took a snapshot, publish anything newer.
+
+  // Implement parser::BasicVTParser callbacks...
+  void on_glyph(const char *data, size_t length);
+  void on_text(const char *data, size_t length);
+  void on_backspace();
+  void on_newline();
+  void on_return();
+  void on_tab();
+  void on_charset(char c);
+  void on_csi(char operation, const parser::CSIParams &args,
+              std::string_view /*options*/);
+  void on_ri();
+  void on_esc(char op);
+  void on_osi(int op, std::string_view);
+  void on_clipboard_begin(std::string_view selection);
+  void on_clipboard_data(const char *data, size_t length);
+  void on_clipboard_end();
+  void on_clipboard_abort();
+
+  static constexpr size_t max_clipboard_length = 4 * 1024 * 1024;
 
   // Helper functions.
   void adjust_cursor(int rows_n, int cols_n);
@@ -32,12 +65,12 @@ public:
   void set_scroll_region(int start_row, int end_row);
   void perform_el(int arg);
   void perform_ed(bool selective, int arg);
-  void csi_m(const std::vector<int> &args);
+  void csi_m(const parser::CSIParams &args);
   void process_di();
   void process_decset(int arg, bool q);
   void process_decrst(int arg, bool q);
   void process_status_report(int arg);
-  keyboard::Mode get_keyboard_mode() const { return kMode; }
+  keyboard::Mode get_keyboard_mode() const { return kMode.load(); }
 };
 
 void run(const gfx::FontSpec&);
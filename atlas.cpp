@@ -0,0 +1,36 @@
+#include "atlas.hpp"
+
+namespace gfx {
+
+ShelfPacker::ShelfPacker(int width, int height) : width{width}, height{height} {}
+
+std::optional<AtlasRect> ShelfPacker::allocate(int w, int h) {
+  if (w <= 0 || h <= 0 || w > width || h > height) {
+    return {};
+  }
+
+  for (auto &shelf : shelves) {
+    // Up to a quarter taller than needed is close enough.
+    if (h <= shelf.height && h * 5 >= shelf.height * 4 &&
+        shelf.used + w <= width) {
+      AtlasRect rect{shelf.used, shelf.y, w, h};
+      shelf.used += w;
+      return rect;
+    }
+  }
+
+  if (next_y + h > height) {
+    return {};
+  }
+
+  shelves.push_back(Shelf{next_y, h, w});
+  next_y += h;
+  return AtlasRect{0, shelves.back().y, w, h};
+}
+
+void ShelfPacker::clear() {
+  shelves.clear();
+  next_y = 0;
+}
+
+} // namespace gfx
@@ -0,0 +1,42 @@
+#pragma once
+#include <optional>
+#include <vector>
+
+namespace gfx {
+
+struct AtlasRect {
+  int x = 0;
+  int y = 0;
+  int w = 0;
+  int h = 0;
+};
+
+class ShelfPacker {
+  // Packs rectangles of varying width into a page, in rows called shelves.
+  // A rectangle goes on the first shelf it fits which isn't much taller than
+  // it, otherwise a new shelf is started below the last. Glyphs of a font are
+  // mostly the same height, so shelves fill with little waste.
+  struct Shelf {
+    int y;
+    int height;
+    int used; // width taken, from the left
+  };
+
+  int width;
+  int height;
+  int next_y = 0;
+  std::vector<Shelf> shelves;
+
+public:
+  ShelfPacker(int width, int height);
+
+  std::optional<AtlasRect> allocate(int w, int h);
+  // Space for a w by h rectangle, if the page has room.
+
+  void clear();
+  // Forget every rectangle, the whole page is free again.
+
+  bool empty() const { return shelves.empty(); }
+};
+
+} // namespace gfx
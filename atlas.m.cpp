@@ -0,0 +1,74 @@
+#include "atlas.hpp"
+
+#include <gtest/gtest.h>
+#include <vector>
+
+TEST(ShelfPacker, Allocate) {
+  gfx::ShelfPacker packer{64, 32};
+
+  // Glyphs of about the same height share a shelf.
+  auto a = packer.allocate(20, 10);
+  auto b = packer.allocate(20, 9);
+  ASSERT_TRUE(a && b);
+  ASSERT_EQ(0, a->y);
+  ASSERT_EQ(0, b->y);
+  ASSERT_EQ(20, b->x);
+
+  // A much taller one starts a new shelf.
+  auto c = packer.allocate(20, 20);
+  ASSERT_TRUE(c);
+  ASSERT_EQ(0, c->x);
+  ASSERT_EQ(10, c->y);
+
+  // With no room on a shelf or below the last, the page is full.
+  ASSERT_FALSE(packer.allocate(30, 10));
+  ASSERT_FALSE(packer.allocate(65, 1));
+
+  packer.clear();
+  ASSERT_TRUE(packer.empty());
+  auto d = packer.allocate(64, 32);
+  ASSERT_TRUE(d);
+  ASSERT_EQ(0, d->y);
+}
+
+TEST(ShelfPacker, RejectsWhatCantFit) {
+  gfx::ShelfPacker packer{64, 32};
+
+  ASSERT_FALSE(packer.allocate(0, 10));
+  ASSERT_FALSE(packer.allocate(10, 0));
+  ASSERT_FALSE(packer.allocate(65, 10));
+  ASSERT_FALSE(packer.allocate(10, 33));
+  ASSERT_TRUE(packer.empty());
+}
+
+TEST(ShelfPacker, FillsWithoutOverlap) {
+  const int size = 128;
+  gfx::ShelfPacker packer{size, size};
+
+  // Glyphs of a few sizes, as a font's are, until the page is full.
+  std::vector<gfx::AtlasRect> placed;
+  for (int i = 0;; i++) {
+    auto rect = packer.allocate(3 + i % 7, 9 + i % 3);
+    if (!rect) {
+      break;
+    }
+    placed.push_back(*rect);
+  }
+
+  int area = 0;
+  for (size_t i = 0; i < placed.size(); i++) {
+    const gfx::AtlasRect &a = placed[i];
+    ASSERT_TRUE(a.x >= 0 && a.y >= 0 && a.x + a.w <= size &&
+                a.y + a.h <= size);
+    area += a.w * a.h;
+
+    for (size_t j = 0; j < i; j++) {
+      const gfx::AtlasRect &b = placed[j];
+      ASSERT_TRUE(a.x + a.w <= b.x || b.x + b.w <= a.x || a.y + a.h <= b.y ||
+                  b.y + b.h <= a.y);
+    }
+  }
+
+  // Similar heights share shelves, so little of the page is wasted.
+  ASSERT_GT(area, size * size * 3 / 4);
+}
@@ -0,0 +1,375 @@
+#include "box_drawing.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace gfx {
+
+namespace {
+
+// The weight of each arm of a box drawing character, from the centre to the
+// edge of the cell: up, right, down and left, two bits each.
+enum Weight : uint8_t { NONE, LIGHT, HEAVY, DOUBLE };
+
+constexpr uint8_t arms(int up, int right, int down, int left) {
+  return static_cast<uint8_t>(up << 6 | right << 4 | down << 2 | left);
+}
+
+// U+2500 to U+257F. Dashes, arcs and diagonals are drawn specially, and
+// have no arms here.
+constexpr uint8_t box_arms[0x80] = {
+    // ─ ━ │ ┃ ┄ ┅ ┆ ┇ ┈ ┉ ┊ ┋
+    arms(0, 1, 0, 1), arms(0, 2, 0, 2), arms(1, 0, 1, 0), arms(2, 0, 2, 0),
+    0, 0, 0, 0, 0, 0, 0, 0,
+    // ┌ ┍ ┎ ┏ ┐ ┑ ┒ ┓
+    arms(0, 1, 1, 0), arms(0, 2, 1, 0), arms(0, 1, 2, 0), arms(0, 2, 2, 0),
+    arms(0, 0, 1, 1), arms(0, 0, 1, 2), arms(0, 0, 2, 1), arms(0, 0, 2, 2),
+    // └ ┕ ┖ ┗ ┘ ┙ ┚ ┛
+    arms(1, 1, 0, 0), arms(1, 2, 0, 0), arms(2, 1, 0, 0), arms(2, 2, 0, 0),
+    arms(1, 0, 0, 1), arms(1, 0, 0, 2), arms(2, 0, 0, 1), arms(2, 0, 0, 2),
+    // ├ ┝ ┞ ┟ ┠ ┡ ┢ ┣
+    arms(1, 1, 1, 0), arms(1, 2, 1, 0), arms(2, 1, 1, 0), arms(1, 1, 2, 0),
+    arms(2, 1, 2, 0), arms(2, 2, 1, 0), arms(1, 2, 2, 0), arms(2, 2, 2, 0),
+    // ┤ ┥ ┦ ┧ ┨ ┩ ┪ ┫
+    arms(1, 0, 1, 1), arms(1, 0, 1, 2), arms(2, 0, 1, 1), arms(1, 0, 2, 1),
+    arms(2, 0, 2, 1), arms(2, 0, 1, 2), arms(1, 0, 2, 2), arms(2, 0, 2, 2),
+    // ┬ ┭ ┮ ┯ ┰ ┱ ┲ ┳
+    arms(0, 1, 1, 1), arms(0, 1, 1, 2), arms(0, 2, 1, 1), arms(0, 2, 1, 2),
+    arms(0, 1, 2, 1), arms(0, 1, 2, 2), arms(0, 2, 2, 1), arms(0, 2, 2, 2),
+    // ┴ ┵ ┶ ┷ ┸ ┹ ┺ ┻
+    arms(1, 1, 0, 1), arms(1, 1, 0, 2), arms(1, 2, 0, 1), arms(1, 2, 0, 2),
+    arms(2, 1, 0, 1), arms(2, 1, 0, 2), arms(2, 2, 0, 1), arms(2, 2, 0, 2),
+    // ┼ ┽ ┾ ┿ ╀ ╁ ╂ ╃
+    arms(1, 1, 1, 1), arms(1, 1, 1, 2), arms(1, 2, 1, 1), arms(1, 2, 1, 2),
+    arms(2, 1, 1, 1), arms(1, 1, 2, 1), arms(2, 1, 2, 1), arms(2, 1, 1, 2),
+    // ╄ ╅ ╆ ╇ ╈ ╉ ╊ ╋
+    arms(2, 2, 1, 1), arms(1, 1, 2, 2), arms(1, 2, 2, 1), arms(2, 2, 1, 2),
+    arms(1, 2, 2, 2), arms(2, 1, 2, 2), arms(2, 2, 2, 1), arms(2, 2, 2, 2),
+    // ╌ ╍ ╎ ╏
+    0, 0, 0, 0,
+    // ═ ║ ╒ ╓ ╔ ╕ ╖ ╗
+    arms(0, 3, 0, 3), arms(3, 0, 3, 0), arms(0, 3, 1, 0), arms(0, 1, 3, 0),
+    arms(0, 3, 3, 0), arms(0, 0, 1, 3), arms(0, 0, 3, 1), arms(0, 0, 3, 3),
+    // ╘ ╙ ╚ ╛ ╜ ╝ ╞ ╟
+    arms(1, 3, 0, 0), arms(3, 1, 0, 0), arms(3, 3, 0, 0), arms(1, 0, 0, 3),
+    arms(3, 0, 0, 1), arms(3, 0, 0, 3), arms(1, 3, 1, 0), arms(3, 1, 3, 0),
+    // ╠ ╡ ╢ ╣ ╤ ╥ ╦ ╧
+    arms(3, 3, 3, 0), arms(1, 0, 1, 3), arms(3, 0, 3, 1), arms(3, 0, 3, 3),
+    arms(0, 3, 1, 3), arms(0, 1, 3, 1), arms(0, 3, 3, 3), arms(1, 3, 0, 3),
+    // ╨ ╩ ╪ ╫ ╬ ╭ ╮ ╯
+    arms(3, 1, 0, 1), arms(3, 3, 0, 3), arms(1, 3, 1, 3), arms(3, 1, 3, 1),
+    arms(3, 3, 3, 3), 0, 0, 0,
+    // ╰ ╱ ╲ ╳ ╴ ╵ ╶ ╷
+    0, 0, 0, 0,
+    arms(0, 0, 0, 1), arms(1, 0, 0, 0), arms(0, 1, 0, 0), arms(0, 0, 1, 0),
+    // ╸ ╹ ╺ ╻ ╼ ╽ ╾ ╿
+    arms(0, 0, 0, 2), arms(2, 0, 0, 0), arms(0, 2, 0, 0), arms(0, 0, 2, 0),
+    arms(0, 2, 0, 1), arms(1, 0, 2, 0), arms(0, 1, 0, 2), arms(2, 0, 1, 0),
+};
+
+struct Canvas {
+  int w;
+  int h;
+  std::vector<uint8_t> &px;
+
+  int light;  // line thickness
+  int heavy;
+  int spread; // from the centre to each line of a double line
+
+  Canvas(int width, int height, std::vector<uint8_t> &coverage)
+      : w{width}, h{height}, px{coverage} {
+    light = std::max(1, std::min(w, h) / 8);
+    heavy = light * 2;
+    spread = light + 1;
+  }
+
+  void fill(int x0, int y0, int x1, int y1, uint8_t alpha = 0xFF) {
+    x0 = std::max(x0, 0);
+    y0 = std::max(y0, 0);
+    x1 = std::min(x1, w);
+    y1 = std::min(y1, h);
+    for (int y = y0; y < y1; y++) {
+      for (int x = x0; x < x1; x++) {
+        uint8_t &p = px[y * w + x];
+        p = std::max(p, alpha);
+      }
+    }
+  }
+
+  void blend(int x, int y, float coverage) {
+    if (x < 0 || y < 0 || x >= w || y >= h || coverage <= 0) {
+      return;
+    }
+    uint8_t alpha =
+        static_cast<uint8_t>(std::lround(std::min(coverage, 1.0f) * 255));
+    uint8_t &p = px[y * w + x];
+    p = std::max(p, alpha);
+  }
+
+  int thickness(int weight) const { return weight == HEAVY ? heavy : light; }
+};
+
+// The pixels a line of thickness t centred on c covers, [begin, end).
+struct Band {
+  int begin;
+  int end;
+};
+
+Band band(int c, int t) { return {c - t / 2, c - t / 2 + t}; }
+
+void draw_arms(Canvas &cv, uint8_t a) {
+  const int weight[4] = {a >> 6 & 3, a >> 4 & 3, a >> 2 & 3, a & 3};
+  enum { UP, RIGHT, DOWN, LEFT };
+
+  const int cx = cv.w / 2;
+  const int cy = cv.h / 2;
+  const int s = cv.spread;
+
+  // Each arm runs from the edge to the centre, and far enough past it to
+  // join the arms across it.
+  for (int arm = 0; arm < 4; arm++) {
+    const int wt = weight[arm];
+    if (wt == NONE) {
+      continue;
+    }
+
+    const bool horizontal = arm == LEFT || arm == RIGHT;
+    const int c = horizontal ? cx : cy;     // centre along the arm
+    const int across = horizontal ? cy : cx; // centre across it
+    const int length = horizontal ? cv.w : cv.h;
+    const bool towards_end = arm == RIGHT || arm == DOWN;
+
+    // The arms across this one, before and after it.
+    const int side[2] = {weight[horizontal ? UP : LEFT],
+                         weight[horizontal ? DOWN : RIGHT]};
+    const bool opposite = weight[(arm + 2) % 4] != NONE;
+    const bool double_across = side[0] == DOUBLE || side[1] == DOUBLE;
+
+    // How far past the centre to reach, given which line across to meet:
+    // near is the nearer of a double line, far the other.
+    auto reach = [&](bool near) {
+      if (double_across) {
+        Band b = band(towards_end == near ? c + s : c - s, cv.light);
+        return towards_end ? b.begin : b.end;
+      }
+      int edge = c;
+      for (int wa : side) {
+        if (wa != NONE) {
+          Band b = band(c, cv.thickness(wa));
+          edge = towards_end ? std::min(edge, b.begin)
+                             : std::max(edge, b.end);
+        }
+      }
+      return edge;
+    };
+
+    auto draw = [&](Band lines, int end) {
+      int from = towards_end ? end : 0;
+      int to = towards_end ? length : end;
+      if (horizontal) {
+        cv.fill(from, lines.begin, to, lines.end);
+      } else {
+        cv.fill(lines.begin, from, lines.end, to);
+      }
+    };
+
+    if (wt != DOUBLE) {
+      // Meeting a double line across from one side only, as in a corner,
+      // reach its far line. Ending at it, as in a tee, only the near one.
+      bool near = !opposite && side[0] == DOUBLE && side[1] == DOUBLE;
+      draw(band(across, cv.thickness(wt)), reach(near));
+      continue;
+    }
+
+    // Each line of a double arm stops at the inner line of a double arm on
+    // its side, otherwise it goes to the outer one.
+    for (int k = 0; k < 2; k++) {
+      Band lines = band(k == 0 ? across - s : across + s, cv.light);
+      if (!double_across) {
+        draw(lines, side[0] || side[1] ? reach(false) : c);
+      } else {
+        draw(lines, reach(side[k] == DOUBLE));
+      }
+    }
+  }
+}
+
+void draw_dashes(Canvas &cv, bool horizontal, int weight, int dashes) {
+  const int length = horizontal ? cv.w : cv.h;
+  Band lines = band(horizontal ? cv.h / 2 : cv.w / 2, cv.thickness(weight));
+  const int gap = std::max(1, length / (dashes * 4));
+
+  for (int i = 0; i < dashes; i++) {
+    int from = i * length / dashes;
+    int to = (i + 1) * length / dashes - gap;
+    if (horizontal) {
+      cv.fill(from, lines.begin, to, lines.end);
+    } else {
+      cv.fill(lines.begin, from, lines.end, to);
+    }
+  }
+}
+
+void draw_arc(Canvas &cv, bool right, bool down) {
+  // A quarter circle joining a line to the centre of one edge with a line
+  // to the centre of the other.
+  const int t = cv.light;
+  Band vb = band(cv.w / 2, t);
+  Band hb = band(cv.h / 2, t);
+  const float lx = (vb.begin + vb.end) / 2.0f;
+  const float ly = (hb.begin + hb.end) / 2.0f;
+
+  const float r =
+      std::max(1.0f, std::min(cv.w, cv.h) / 2.0f - static_cast<float>(t));
+  const float ccx = lx + (right ? r : -r);
+  const float ccy = ly + (down ? r : -r);
+
+  // The straight parts, from where the circle ends to the edges.
+  const int ex = static_cast<int>(std::floor(ccx));
+  const int ey = static_cast<int>(std::floor(ccy));
+  if (right) {
+    cv.fill(ex, hb.begin, cv.w, hb.end);
+  } else {
+    cv.fill(0, hb.begin, ex + 1, hb.end);
+  }
+  if (down) {
+    cv.fill(vb.begin, ey, vb.end, cv.h);
+  } else {
+    cv.fill(vb.begin, 0, vb.end, ey + 1);
+  }
+
+  for (int y = 0; y < cv.h; y++) {
+    for (int x = 0; x < cv.w; x++) {
+      float px = x + 0.5f;
+      float py = y + 0.5f;
+      if ((right ? px > ccx : px < ccx) || (down ? py > ccy : py < ccy)) {
+        continue;
+      }
+      float d = std::hypot(px - ccx, py - ccy);
+      cv.blend(x, y, t / 2.0f + 0.5f - std::fabs(d - r));
+    }
+  }
+}
+
+void draw_diagonal(Canvas &cv, bool rising) {
+  // From corner to corner, so diagonals join up across cells.
+  const float x0 = 0;
+  const float y0 = rising ? static_cast<float>(cv.h) : 0;
+  const float x1 = static_cast<float>(cv.w);
+  const float y1 = rising ? 0 : static_cast<float>(cv.h);
+  const float length = std::hypot(x1 - x0, y1 - y0);
+
+  for (int y = 0; y < cv.h; y++) {
+    for (int x = 0; x < cv.w; x++) {
+      float px = x + 0.5f;
+      float py = y + 0.5f;
+      float d = std::fabs((y1 - y0) * px - (x1 - x0) * py + x1 * y0 - y1 * x0) /
+                length;
+      cv.blend(x, y, cv.light / 2.0f + 0.5f - d);
+    }
+  }
+}
+
+bool draw_block(Canvas &cv, uint32_t cp) {
+  const int w = cv.w;
+  const int h = cv.h;
+  auto eighths = [](int size, int n) { return (size * n + 4) / 8; };
+
+  if (cp == 0x2580) { // ▀
+    cv.fill(0, 0, w, h / 2);
+  } else if (cp >= 0x2581 && cp <= 0x2588) { // ▁ to █, from the bottom
+    cv.fill(0, h - eighths(h, static_cast<int>(cp - 0x2580)), w, h);
+  } else if (cp >= 0x2589 && cp <= 0x258F) { // ▉ to ▏, from the left
+    cv.fill(0, 0, eighths(w, static_cast<int>(0x2590 - cp)), h);
+  } else if (cp == 0x2590) { // ▐
+    cv.fill(w / 2, 0, w, h);
+  } else if (cp >= 0x2591 && cp <= 0x2593) { // ░ ▒ ▓
+    cv.fill(0, 0, w, h, static_cast<uint8_t>(0x40 * (cp - 0x2590)));
+  } else if (cp == 0x2594) { // ▔
+    cv.fill(0, 0, w, eighths(h, 1));
+  } else if (cp == 0x2595) { // ▕
+    cv.fill(w - eighths(w, 1), 0, w, h);
+  } else if (cp >= 0x2596 && cp <= 0x259F) {
+    // Quadrants: upper left, upper right, lower left, lower right.
+    static constexpr uint8_t quadrants[10] = {
+        4, 8, 1, 1 | 4 | 8, 1 | 8, 1 | 2 | 4, 1 | 2 | 8, 2, 2 | 4, 2 | 4 | 8};
+    uint8_t q = quadrants[cp - 0x2596];
+    if (q & 1)
+      cv.fill(0, 0, w / 2, h / 2);
+    if (q & 2)
+      cv.fill(w / 2, 0, w, h / 2);
+    if (q & 4)
+      cv.fill(0, h / 2, w / 2, h);
+    if (q & 8)
+      cv.fill(w / 2, h / 2, w, h);
+  } else {
+    return false;
+  }
+  return true;
+}
+
+} // namespace
+
+bool is_box_drawing(uint32_t cp) {
+  return (cp >= 0x2500 && cp <= 0x259F) || (cp >= 0x23BA && cp <= 0x23BD);
+}
+
+bool draw_box(uint32_t cp, int width, int height,
+              std::vector<uint8_t> &coverage) {
+  if (!is_box_drawing(cp) || width <= 0 || height <= 0) {
+    return false;
+  }
+
+  coverage.assign(static_cast<size_t>(width) * height, 0);
+  Canvas cv{width, height, coverage};
+
+  if (cp >= 0x23BA && cp <= 0x23BD) {
+    // Scan lines 1, 3, 7 and 9 of 9, from DEC special graphics.
+    static constexpr int scan[4] = {1, 3, 7, 9};
+    int y = height * (2 * scan[cp - 0x23BA] - 1) / 18;
+    Band b = band(y, cv.light);
+    cv.fill(0, b.begin, width, b.end);
+    return true;
+  }
+
+  if (cp >= 0x2580) {
+    return draw_block(cv, cp);
+  }
+
+  switch (cp) {
+  case 0x2504: case 0x2505: // ┄ ┅
+    draw_dashes(cv, true, cp == 0x2505 ? HEAVY : LIGHT, 3);
+    break;
+  case 0x2506: case 0x2507: // ┆ ┇
+    draw_dashes(cv, false, cp == 0x2507 ? HEAVY : LIGHT, 3);
+    break;
+  case 0x2508: case 0x2509: // ┈ ┉
+    draw_dashes(cv, true, cp == 0x2509 ? HEAVY : LIGHT, 4);
+    break;
+  case 0x250A: case 0x250B: // ┊ ┋
+    draw_dashes(cv, false, cp == 0x250B ? HEAVY : LIGHT, 4);
+    break;
+  case 0x254C: case 0x254D: // ╌ ╍
+    draw_dashes(cv, true, cp == 0x254D ? HEAVY : LIGHT, 2);
+    break;
+  case 0x254E: case 0x254F: // ╎ ╏
+    draw_dashes(cv, false, cp == 0x254F ? HEAVY : LIGHT, 2);
+    break;
+  case 0x256D: draw_arc(cv, true, true); break;   // ╭
+  case 0x256E: draw_arc(cv, false, true); break;  // ╮
+  case 0x256F: draw_arc(cv, false, false); break; // ╯
+  case 0x2570: draw_arc(cv, true, false); break;  // ╰
+  case 0x2571: draw_diagonal(cv, true); break;    // ╱
+  case 0x2572: draw_diagonal(cv, false); break;   // ╲
+  case 0x2573:                                    // ╳
+    draw_diagonal(cv, true);
+    draw_diagonal(cv, false);
+    break;
+  default:
+    draw_arms(cv, box_arms[cp - 0x2500]);
+    break;
+  }
+  return true;
+}
+
+} // namespace gfx
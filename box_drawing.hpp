@@ -0,0 +1,18 @@
+#pragma once
+#include <stdint.h>
+#include <vector>
+
+namespace gfx {
+
+bool is_box_drawing(uint32_t cp);
+// Whether cp is drawn by draw_box rather than from the font: box drawing and
+// block elements, U+2500 to U+259F, and the scan lines of DEC special
+// graphics.
+
+bool draw_box(uint32_t cp, int width, int height,
+              std::vector<uint8_t> &coverage);
+// Draw cp as a width by height coverage mask, a byte a pixel, row by row.
+// Lines meet the cell edges exactly, so they join up across cells. False if
+// cp isn't drawn here.
+
+} // namespace gfx
@@ -0,0 +1,147 @@
+#include "box_drawing.hpp"
+
+#include <algorithm>
+#include <gtest/gtest.h>
+#include <stdint.h>
+#include <vector>
+
+TEST(BoxDrawing, FillsTheCell) {
+  const int w = 10, h = 20;
+  std::vector<uint8_t> c;
+
+  ASSERT_FALSE(gfx::draw_box('a', w, h, c));
+
+  // █ covers everything, ▌ exactly the left half.
+  ASSERT_TRUE(gfx::draw_box(0x2588, w, h, c));
+  ASSERT_EQ(size_t{w * h}, c.size());
+  ASSERT_TRUE(std::all_of(c.begin(), c.end(), [](uint8_t a) { return a == 0xFF; }));
+
+  ASSERT_TRUE(gfx::draw_box(0x258C, w, h, c));
+  for (int y = 0; y < h; y++)
+    for (int x = 0; x < w; x++)
+      ASSERT_EQ(x < w / 2 ? 0xFF : 0, c[y * w + x]);
+
+  // ┼ reaches all four edges, so it joins its neighbours, and leaves the
+  // corners empty.
+  ASSERT_TRUE(gfx::draw_box(0x253C, w, h, c));
+  ASSERT_EQ(0xFF, c[h / 2 * w]);
+  ASSERT_EQ(0xFF, c[h / 2 * w + w - 1]);
+  ASSERT_EQ(0xFF, c[w / 2]);
+  ASSERT_EQ(0xFF, c[(h - 1) * w + w / 2]);
+  ASSERT_EQ(0, c[0]);
+  ASSERT_EQ(0, c[h * w - 1]);
+
+  // ╔ has nothing above or left of its outer lines.
+  ASSERT_TRUE(gfx::draw_box(0x2554, w, h, c));
+  ASSERT_EQ(0, c[0]);
+  ASSERT_EQ(0xFF, c[(h - 1) * w + w / 2 - 2]);
+  ASSERT_EQ(0xFF, c[(h / 2 - 2) * w + w - 1]);
+}
+
+namespace {
+
+// Coverage summed over rows [y0, y1) of a width w mask.
+int coverage(const std::vector<uint8_t> &c, int w, int y0, int y1) {
+  int sum = 0;
+  for (int i = y0 * w; i < y1 * w; i++)
+    sum += c[i];
+  return sum;
+}
+
+// How many rows the column at x covers.
+int column_rows(const std::vector<uint8_t> &c, int w, int h, int x) {
+  int rows = 0;
+  for (int y = 0; y < h; y++)
+    rows += c[y * w + x] != 0;
+  return rows;
+}
+
+} // namespace
+
+TEST(BoxDrawing, Ranges) {
+  ASSERT_TRUE(gfx::is_box_drawing(0x2500));
+  ASSERT_TRUE(gfx::is_box_drawing(0x259F));
+  ASSERT_TRUE(gfx::is_box_drawing(0x23BA));
+  ASSERT_TRUE(gfx::is_box_drawing(0x23BD));
+  ASSERT_FALSE(gfx::is_box_drawing(0x24FF));
+  ASSERT_FALSE(gfx::is_box_drawing(0x25A0));
+  ASSERT_FALSE(gfx::is_box_drawing(0x23B9));
+  ASSERT_FALSE(gfx::is_box_drawing(0x23BE));
+
+  // Nothing to draw into.
+  std::vector<uint8_t> c;
+  ASSERT_FALSE(gfx::draw_box(0x2500, 0, 20, c));
+  ASSERT_FALSE(gfx::draw_box(0x2500, 10, 0, c));
+}
+
+TEST(BoxDrawing, Shades) {
+  const int w = 10, h = 20;
+  std::vector<uint8_t> c;
+
+  // ░ ▒ ▓ are flat, each darker than the last.
+  int last = 0;
+  for (uint32_t cp = 0x2591; cp <= 0x2593; cp++) {
+    ASSERT_TRUE(gfx::draw_box(cp, w, h, c));
+    ASSERT_TRUE(std::all_of(c.begin(), c.end(), [&](uint8_t a) { return a == c[0]; }));
+    ASSERT_GT(c[0], last);
+    last = c[0];
+  }
+  ASSERT_LT(last, 0xFF);
+}
+
+TEST(BoxDrawing, BlocksAndQuadrants) {
+  const int w = 10, h = 20;
+  std::vector<uint8_t> c;
+
+  // ▀ is the top half, ▄ the bottom.
+  ASSERT_TRUE(gfx::draw_box(0x2580, w, h, c));
+  ASSERT_EQ(w * (h / 2) * 0xFF, coverage(c, w, 0, h / 2));
+  ASSERT_EQ(0, coverage(c, w, h / 2, h));
+  ASSERT_TRUE(gfx::draw_box(0x2584, w, h, c));
+  ASSERT_EQ(0, coverage(c, w, 0, h / 2));
+  ASSERT_EQ(w * (h / 2) * 0xFF, coverage(c, w, h / 2, h));
+
+  // ▁ to █ grow from the bottom.
+  int last = 0;
+  for (uint32_t cp = 0x2581; cp <= 0x2588; cp++) {
+    ASSERT_TRUE(gfx::draw_box(cp, w, h, c));
+    int total = coverage(c, w, 0, h);
+    ASSERT_GT(total, last);
+    ASSERT_EQ(0xFF, c[(h - 1) * w]);
+    last = total;
+  }
+
+  // ▘ is the top left quadrant only.
+  ASSERT_TRUE(gfx::draw_box(0x2598, w, h, c));
+  for (int y = 0; y < h; y++)
+    for (int x = 0; x < w; x++)
+      ASSERT_EQ(x < w / 2 && y < h / 2 ? 0xFF : 0, c[y * w + x]);
+}
+
+TEST(BoxDrawing, Lines) {
+  const int w = 10, h = 20;
+  std::vector<uint8_t> c;
+
+  // ─ spans the width, ━ the same but thicker.
+  ASSERT_TRUE(gfx::draw_box(0x2500, w, h, c));
+  int light = column_rows(c, w, h, 0);
+  ASSERT_GT(light, 0);
+  ASSERT_EQ(light, column_rows(c, w, h, w - 1));
+  ASSERT_TRUE(gfx::draw_box(0x2501, w, h, c));
+  ASSERT_GT(column_rows(c, w, h, 0), light);
+
+  // ┄ is broken up, so some columns are empty.
+  ASSERT_TRUE(gfx::draw_box(0x2504, w * 3, h, c));
+  int gaps = 0;
+  for (int x = 0; x < w * 3; x++)
+    gaps += column_rows(c, w * 3, h, x) == 0;
+  ASSERT_GT(gaps, 0);
+
+  // ⎺ is a scan line near the top, ⎽ near the bottom.
+  ASSERT_TRUE(gfx::draw_box(0x23BA, w, h, c));
+  ASSERT_GT(coverage(c, w, 0, h / 4), 0);
+  ASSERT_EQ(0, coverage(c, w, h / 2, h));
+  ASSERT_TRUE(gfx::draw_box(0x23BD, w, h, c));
+  ASSERT_EQ(0, coverage(c, w, 0, h / 2));
+  ASSERT_GT(coverage(c, w, h * 3 / 4, h), 0);
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define PEACHTERM_CELLDIFF_SSE2
+#endif
+
+#include "termcell.hpp"
+#include "util.hpp"
+
+namespace gfx {
+
+// Vectorised compare of a row of cells against what was drawn before. Cells
+// are fixed width and compared bytewise, several to a vector.
+//
+// find_changed: first cell of [begin, end) which differs from the cell at
+//               the same offset from other, or end if there is none.
+
+inline const TermCell *find_changed(const TermCell *begin, const TermCell *end,
+                                    const TermCell *other) {
+  static_assert(sizeof(TermCell) == 8, "four cells to an AVX2 vector");
+
+#if defined(__AVX2__)
+  for (; end - begin >= 4; begin += 4, other += 4) {
+    __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(begin));
+    __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(other));
+    uint32_t mask =
+        ~static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, b)));
+    if (mask) {
+      return begin + util::lowest_bit(mask) / sizeof(TermCell);
+    }
+  }
+#elif defined(PEACHTERM_CELLDIFF_SSE2)
+  for (; end - begin >= 2; begin += 2, other += 2) {
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(begin));
+    __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(other));
+    uint32_t mask =
+        ~static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(a, b))) &
+        0xFFFFu;
+    if (mask) {
+      return begin + util::lowest_bit(mask) / sizeof(TermCell);
+    }
+  }
+#endif
+
+  for (; begin != end; ++begin, ++other) {
+    if (*begin != *other) {
+      break;
+    }
+  }
+
+  return begin;
+}
+
+} // namespace gfx
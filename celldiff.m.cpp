@@ -0,0 +1,66 @@
+#include "celldiff.hpp"
+
+#include <gtest/gtest.h>
+#include <vector>
+
+TEST(CellDiff, FindsEachChange) {
+  std::vector<gfx::TermCell> drawn(37);
+
+  for (size_t changed = 0; changed < drawn.size(); changed++) {
+    for (int field = 0; field < 2; field++) {
+      std::vector<gfx::TermCell> cells = drawn;
+      if (field == 0)
+        cells[changed].glyph = gfx::Glyph::code_point('x');
+      else
+        cells[changed].style = 0x10001;
+
+      const gfx::TermCell *begin = cells.data();
+      const gfx::TermCell *end = cells.data() + cells.size();
+
+      ASSERT_EQ(begin + changed, gfx::find_changed(begin, end, drawn.data()));
+
+      // Starting after the changed cell finds nothing.
+      ASSERT_EQ(end, gfx::find_changed(begin + changed + 1, end,
+                                       drawn.data() + changed + 1));
+    }
+  }
+}
+
+TEST(CellDiff, EveryLength) {
+  // Rows of every length up to a few vectors, so each ends partway through
+  // one and the tail is compared a cell at a time.
+  for (size_t length = 0; length < 13; length++) {
+    std::vector<gfx::TermCell> drawn(length);
+    std::vector<gfx::TermCell> cells = drawn;
+
+    const gfx::TermCell *begin = cells.data();
+    const gfx::TermCell *end = cells.data() + cells.size();
+    ASSERT_EQ(end, gfx::find_changed(begin, end, drawn.data()));
+
+    if (length > 0) {
+      cells.back().glyph = gfx::Glyph::empty();
+      ASSERT_EQ(end - 1, gfx::find_changed(begin, end, drawn.data()));
+    }
+  }
+}
+
+TEST(CellDiff, FirstOfSeveral) {
+  std::vector<gfx::TermCell> drawn(16);
+  std::vector<gfx::TermCell> cells = drawn;
+
+  // Only the top byte of the style differs in the first.
+  cells[5].style = 0x01000000;
+  cells[6].glyph = gfx::Glyph::code_point('y');
+  cells[12].style = 1;
+
+  const gfx::TermCell *begin = cells.data();
+  const gfx::TermCell *end = cells.data() + cells.size();
+  const gfx::TermCell *found = gfx::find_changed(begin, end, drawn.data());
+  ASSERT_EQ(begin + 5, found);
+
+  found = gfx::find_changed(found + 1, end, drawn.data() + 6);
+  ASSERT_EQ(begin + 6, found);
+
+  found = gfx::find_changed(found + 1, end, drawn.data() + 7);
+  ASSERT_EQ(begin + 12, found);
+}
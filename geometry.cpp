@@ -0,0 +1,64 @@
+#include "geometry.hpp"
+
+namespace gfx {
+
+void QuadBatch::fill(const SDL_Rect &rect, SDL_Color colour) {
+  const float x0 = static_cast<float>(rect.x);
+  const float y0 = static_cast<float>(rect.y);
+  const float x1 = static_cast<float>(rect.x + rect.w);
+  const float y1 = static_cast<float>(rect.y + rect.h);
+
+  if (!vertices.empty()) {
+    // Vertices go top left, top right, bottom right, bottom left.
+    SDL_Vertex *last = vertices.data() + vertices.size() - 4;
+    const SDL_Color &c = last[0].color;
+
+    if (last[1].position.x == x0 && last[0].position.y == y0 &&
+        last[2].position.y == y1 && c.r == colour.r && c.g == colour.g &&
+        c.b == colour.b && c.a == colour.a) {
+      last[1].position.x = last[2].position.x = x1;
+      return;
+    }
+  }
+
+  add(x0, y0, x1, y1, colour, 0, 0, 0, 0);
+}
+
+void QuadBatch::copy(const SDL_Rect &src, const SDL_Rect &dst,
+                     SDL_Color colour, int tex_width, int tex_height) {
+  const float w = static_cast<float>(tex_width);
+  const float h = static_cast<float>(tex_height);
+
+  add(static_cast<float>(dst.x), static_cast<float>(dst.y),
+      static_cast<float>(dst.x + dst.w), static_cast<float>(dst.y + dst.h),
+      colour, src.x / w, src.y / h, (src.x + src.w) / w, (src.y + src.h) / h);
+}
+
+void QuadBatch::add(float x0, float y0, float x1, float y1, SDL_Color colour,
+                    float u0, float v0, float u1, float v1) {
+  const int first = static_cast<int>(vertices.size());
+
+  vertices.push_back(SDL_Vertex{{x0, y0}, colour, {u0, v0}});
+  vertices.push_back(SDL_Vertex{{x1, y0}, colour, {u1, v0}});
+  vertices.push_back(SDL_Vertex{{x1, y1}, colour, {u1, v1}});
+  vertices.push_back(SDL_Vertex{{x0, y1}, colour, {u0, v1}});
+
+  for (int i : {0, 1, 2, 0, 2, 3}) {
+    indices.push_back(first + i);
+  }
+}
+
+void QuadBatch::submit(SDL_Renderer *ren, SDL_Texture *tex) {
+  if (vertices.empty()) {
+    return;
+  }
+
+  SDL_RenderGeometry(ren, tex, vertices.data(),
+                     static_cast<int>(vertices.size()), indices.data(),
+                     static_cast<int>(indices.size()));
+
+  vertices.clear();
+  indices.clear();
+}
+
+} // namespace gfx
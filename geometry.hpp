@@ -0,0 +1,33 @@
+#pragma once
+#include <SDL.h>
+#include <vector>
+
+namespace gfx {
+
+class QuadBatch {
+  // Rectangles queued to be drawn by a single SDL_RenderGeometry call, four
+  // vertices and two triangles each. Vertex colours tint the texture, or are
+  // the fill when there's none.
+  std::vector<SDL_Vertex> vertices;
+  std::vector<int> indices;
+
+public:
+  void fill(const SDL_Rect &rect, SDL_Color colour);
+  // A solid rectangle. When the last one queued is the same colour and ends
+  // where this starts, on the same line, it's extended instead.
+
+  void copy(const SDL_Rect &src, const SDL_Rect &dst, SDL_Color colour,
+            int tex_width, int tex_height);
+  // The src part of a tex_width by tex_height texture, drawn at dst.
+
+  void submit(SDL_Renderer *ren, SDL_Texture *tex);
+  // Draw everything queued, with tex, and empty the batch.
+
+  bool empty() const { return vertices.empty(); }
+
+private:
+  void add(float x0, float y0, float x1, float y1, SDL_Color colour, float u0,
+           float v0, float u1, float v1);
+};
+
+} // namespace gfx
@@ -0,0 +1,117 @@
+#include "glyph_cache.hpp"
+
+#include <stdint.h>
+#include <string.h>
+#include <utility>
+
+namespace gfx {
+
+uint32_t GlyphCache::hash(const void *font, std::string_view text) {
+  // FNV-1a over the text, seeded by the font, then a 64 bit finaliser so the
+  // low bits used as the index depend on every byte.
+  uint64_t h = 0xCBF29CE484222325ull ^ reinterpret_cast<uintptr_t>(font);
+  for (char c : text) {
+    h ^= static_cast<unsigned char>(c);
+    h *= 0x100000001B3ull;
+  }
+
+  h ^= h >> 30;
+  h *= 0xBF58476D1CE4E5B9ull;
+  h ^= h >> 27;
+  h *= 0x94D049BB133111EBull;
+  h ^= h >> 31;
+  return static_cast<uint32_t>(h);
+}
+
+std::string_view GlyphCache::key(const Slot &slot) const {
+  if (slot.length <= inline_size) {
+    return {slot.text, slot.length};
+  }
+  return {long_keys.data() + slot.offset, slot.length};
+}
+
+const GlyphCache::Entry *GlyphCache::find(const void *font,
+                                          std::string_view text) const {
+  if (slots.empty()) {
+    return nullptr;
+  }
+
+  const uint32_t h = hash(font, text);
+  const size_t mask = slots.size() - 1;
+
+  for (size_t i = h & mask;; i = (i + 1) & mask) {
+    const Slot &slot = slots[i];
+    if (slot.font == nullptr) {
+      return nullptr;
+    }
+    if (slot.hash == h && slot.font == font && key(slot) == text) {
+      return &slot.entry;
+    }
+  }
+}
+
+const GlyphCache::Entry *GlyphCache::insert(const void *font,
+                                            std::string_view text,
+                                            Entry entry) {
+  if ((count + 1) * 2 > slots.size()) {
+    rebuild(slots.empty() ? min_capacity : slots.size() * 2, -1);
+  }
+
+  return place(font, text, hash(font, text), entry);
+}
+
+const GlyphCache::Entry *GlyphCache::place(const void *font,
+                                           std::string_view text, uint32_t h,
+                                           Entry entry) {
+  const size_t mask = slots.size() - 1;
+
+  size_t i = h & mask;
+  while (slots[i].font != nullptr) {
+    i = (i + 1) & mask;
+  }
+
+  Slot &slot = slots[i];
+  slot.font = font;
+  slot.hash = h;
+  slot.length = static_cast<uint32_t>(text.size());
+  if (text.size() <= inline_size) {
+    memcpy(slot.text, text.data(), text.size());
+  } else {
+    slot.offset = static_cast<uint32_t>(long_keys.size());
+    long_keys.append(text);
+  }
+  slot.entry = entry;
+  count++;
+  return &slot.entry;
+}
+
+void GlyphCache::erase_page(int page) { rebuild(slots.size(), page); }
+
+void GlyphCache::rebuild(size_t capacity, int drop_page) {
+  // Rare, on growth and page eviction, so simply reinsert what's kept. This
+  // also compacts the long keys.
+  std::vector<Slot> old_slots(capacity);
+  std::string old_long_keys;
+  std::swap(old_slots, slots);
+  std::swap(old_long_keys, long_keys);
+  count = 0;
+
+  for (const Slot &slot : old_slots) {
+    if (slot.font == nullptr || slot.entry.page == drop_page) {
+      continue;
+    }
+    std::string_view text =
+        slot.length <= inline_size
+            ? std::string_view{slot.text, slot.length}
+            : std::string_view{old_long_keys.data() + slot.offset, slot.length};
+    place(slot.font, text, slot.hash, slot.entry);
+  }
+}
+
+void GlyphCache::clear() {
+  slots.clear();
+  long_keys.clear();
+  count = 0;
+}
+
+} // namespace gfx
@@ -0,0 +1,74 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "atlas.hpp"
+
+namespace gfx {
+
+class GlyphCache {
+  // Where each rasterized glyph is in the atlas, by font and glyph text. An
+  // open addressed table with linear probing, looked up for every drawn
+  // cell. Keys of up to inline_size bytes, which is nearly every glyph, are
+  // held in the slot, longer clusters in a side buffer, so a lookup never
+  // allocates.
+public:
+  struct Entry {
+    int page = 0;
+    AtlasRect rect;
+  };
+
+private:
+  static constexpr size_t inline_size = 16;
+  static constexpr size_t min_capacity = 1024;
+
+  struct Slot {
+    const void *font = nullptr; // nullptr for a free slot
+    uint32_t hash = 0;
+    uint32_t length = 0;
+    uint32_t offset = 0; // into long_keys, when longer than inline_size
+    char text[inline_size];
+    Entry entry;
+  };
+
+  std::vector<Slot> slots; // a power of two, at most half full
+  std::string long_keys;
+  size_t count = 0;
+
+public:
+  const Entry *find(const void *font, std::string_view text) const;
+  // The entry for the glyph, nullptr if it isn't cached.
+
+  const Entry *insert(const void *font, std::string_view text, Entry entry);
+  // Add the glyph, which mustn't be cached already.
+
+  void erase_page(int page);
+  // Drop every glyph on the page, when it's reused.
+
+  void clear();
+
+  size_t size() const { return count; }
+
+  template <typename F> void for_each(F &&f) const {
+    // Call f(font, text, entry) for every cached glyph.
+    for (const Slot &slot : slots) {
+      if (slot.font != nullptr) {
+        f(slot.font, key(slot), slot.entry);
+      }
+    }
+  }
+
+  static uint32_t hash(const void *font, std::string_view text);
+
+private:
+  std::string_view key(const Slot &slot) const;
+  const Entry *place(const void *font, std::string_view text, uint32_t hash,
+                     Entry entry);
+  void rebuild(size_t capacity, int drop_page);
+  // Reinsert into a table of capacity slots, leaving out drop_page's glyphs.
+};
+
+} // namespace gfx
@@ -0,0 +1,95 @@
+#include "glyph_cache.hpp"
+
+#include <gtest/gtest.h>
+#include <string>
+#include <string_view>
+
+TEST(GlyphCache, FindInsertErase) {
+  gfx::GlyphCache cache;
+  int regular, bold;
+
+  ASSERT_EQ(nullptr, cache.find(&regular, "a"));
+
+  // Enough glyphs to grow the table, some too long to store inline.
+  for (int i = 0; i < 3000; i++) {
+    std::string text = std::to_string(i);
+    if (i % 7 == 0)
+      text += " a long grapheme cluster";
+    cache.insert(i % 2 ? &bold : &regular, text,
+                 gfx::GlyphCache::Entry{i % 3, gfx::AtlasRect{i, 0, 1, 1}});
+  }
+  ASSERT_EQ(3000u, cache.size());
+
+  for (int i = 0; i < 3000; i++) {
+    std::string text = std::to_string(i);
+    if (i % 7 == 0)
+      text += " a long grapheme cluster";
+    auto *entry = cache.find(i % 2 ? &bold : &regular, text);
+    ASSERT_NE(nullptr, entry);
+    ASSERT_EQ(i, entry->rect.x);
+    // Keyed by font too.
+    ASSERT_EQ(nullptr, cache.find(i % 2 ? &regular : &bold, text));
+  }
+
+  cache.erase_page(1);
+  ASSERT_EQ(2000u, cache.size());
+
+  size_t visited = 0;
+  cache.for_each([&](const void *, std::string_view,
+                     const gfx::GlyphCache::Entry &entry) {
+    ASSERT_NE(1, entry.page);
+    visited++;
+  });
+  ASSERT_EQ(cache.size(), visited);
+  for (int i = 0; i < 3000; i++) {
+    std::string text = std::to_string(i);
+    if (i % 7 == 0)
+      text += " a long grapheme cluster";
+    ASSERT_EQ(i % 3 != 1,
+              cache.find(i % 2 ? &bold : &regular, text) != nullptr);
+  }
+}
+
+TEST(GlyphCache, KeyLengths) {
+  gfx::GlyphCache cache;
+  int font = 0;
+
+  // Keys either side of the inline size, sharing a prefix, and empty.
+  const std::string long_text(40, 'x');
+  for (int length = 0; length <= 40; length++) {
+    cache.insert(&font, std::string_view{long_text}.substr(0, length),
+                 gfx::GlyphCache::Entry{0, gfx::AtlasRect{length, 0, 1, 1}});
+  }
+
+  for (int length = 0; length <= 40; length++) {
+    auto *entry =
+        cache.find(&font, std::string_view{long_text}.substr(0, length));
+    ASSERT_NE(nullptr, entry);
+    ASSERT_EQ(length, entry->rect.x);
+  }
+  ASSERT_EQ(nullptr, cache.find(&font, long_text + "x"));
+
+  // The long keys survive the rebuild of erasing a page.
+  cache.erase_page(1);
+  ASSERT_EQ(41u, cache.size());
+  auto *entry = cache.find(&font, long_text);
+  ASSERT_NE(nullptr, entry);
+  ASSERT_EQ(40, entry->rect.x);
+}
+
+TEST(GlyphCache, Clear) {
+  gfx::GlyphCache cache;
+  int font = 0;
+
+  const auto *inserted =
+      cache.insert(&font, "a", gfx::GlyphCache::Entry{2, gfx::AtlasRect{}});
+  ASSERT_EQ(inserted, cache.find(&font, "a"));
+  ASSERT_EQ(2, inserted->page);
+
+  cache.clear();
+  ASSERT_EQ(0u, cache.size());
+  ASSERT_EQ(nullptr, cache.find(&font, "a"));
+
+  cache.insert(&font, "a", gfx::GlyphCache::Entry{3, gfx::AtlasRect{}});
+  ASSERT_EQ(3, cache.find(&font, "a")->page);
+}
@@ -0,0 +1,51 @@
+#include "grapheme_pool.hpp"
+
+namespace gfx {
+
+Glyph GraphemePool::intern(const char *text, size_t length) {
+  const char *pos = text;
+  const char *end = text + length;
+
+  uint32_t cp = unicode::decode_utf8(pos, end);
+
+  if (pos == end) {
+    return Glyph::code_point(cp);
+  }
+
+  std::string key{text, length};
+
+  auto found = lookup.find(key);
+  if (found != lookup.end()) {
+    uint32_t index = found->second;
+    return Glyph::pooled(index, entries[index].generation);
+  }
+
+  uint32_t index;
+  if (!free_slots.empty()) {
+    index = free_slots.back();
+    free_slots.pop_back();
+  } else if (entries.size() <= Glyph::index_mask) {
+    index = static_cast<uint32_t>(entries.size());
+    entries.emplace_back();
+    texts.emplace_back();
+  } else {
+    // Out of handles.
+    return Glyph::code_point(0xFFFD);
+  }
+
+  texts[index] = key;
+  lookup.emplace(std::move(key), index);
+  texts_version++;
+
+  return Glyph::pooled(index, entries[index].generation);
+}
+
+void GraphemePool::free(uint32_t index) {
+  lookup.erase(texts[index]);
+  std::string{}.swap(texts[index]);
+
+  entries[index].generation++;
+  free_slots.push_back(index);
+}
+
+} // namespace gfx
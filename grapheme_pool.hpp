@@ -0,0 +1,73 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "termcell.hpp"
+
+namespace gfx {
+
+class GraphemePool {
+  // Interns the grapheme clusters of more than one code point, so every cell
+  // showing one shares a single copy. Entries are reference counted by the
+  // cells holding them, on the screens and in the scrollback. A freed slot
+  // is reused with a new generation, so a stale handle never equals a new
+  // one.
+  struct Entry {
+    uint32_t refs = 0;
+    uint32_t generation = 0;
+  };
+
+  std::vector<Entry> entries;
+  std::vector<std::string> texts;
+  std::unordered_map<std::string, uint32_t> lookup;
+  std::vector<uint32_t> free_slots;
+
+  uint64_t texts_version = 0;
+
+public:
+  GraphemePool() = default;
+
+  GraphemePool(const GraphemePool &) = delete;
+  GraphemePool &operator=(const GraphemePool &) = delete;
+
+  Glyph intern(const char *text, size_t length);
+  // The glyph for the cluster, single code points are stored inline. The
+  // entry starts with no references, it lives until the last release.
+
+  void retain(Glyph glyph) {
+    if (glyph.is_pooled()) {
+      entries[glyph.index()].refs++;
+    }
+  }
+
+  void release(Glyph glyph) {
+    if (glyph.is_pooled() && --entries[glyph.index()].refs == 0) {
+      free(glyph.index());
+    }
+  }
+
+  void discard(Glyph glyph) {
+    if (glyph.is_pooled() && entries[glyph.index()].refs == 0) {
+      free(glyph.index());
+    }
+  }
+  // Free the entry of a glyph just interned if it was never written, e.g.
+  // when it fell outside the grid.
+
+  const std::vector<std::string> &pooled() const { return texts; }
+  // The text of each entry, by index. See glyph_text.
+
+  uint64_t version() const { return texts_version; }
+  // Changes whenever an entry is added.
+
+  size_t size() const { return lookup.size(); }
+
+private:
+  void free(uint32_t index);
+};
+
+} // namespace gfx
@@ -0,0 +1,112 @@
+#include "grapheme_pool.hpp"
+
+#include <gtest/gtest.h>
+#include <string>
+#include <string_view>
+
+TEST(GraphemePool, Intern) {
+  gfx::GraphemePool pool;
+  char utf8[4];
+
+  auto text = [&](gfx::Glyph g) {
+    return std::string{gfx::glyph_text(g, pool.pooled(), utf8)};
+  };
+
+  // Single code points are stored in the glyph itself.
+  gfx::Glyph euro = pool.intern("\xE2\x82\xAC", 3);
+  EXPECT_FALSE(euro.is_pooled());
+  EXPECT_EQ("\xE2\x82\xAC", text(euro));
+  EXPECT_EQ(0u, pool.size());
+
+  std::string flag = "\xF0\x9F\x87\xAC\xF0\x9F\x87\xA7";
+  gfx::Glyph a = pool.intern(flag.data(), flag.size());
+  gfx::Glyph b = pool.intern(flag.data(), flag.size());
+  EXPECT_TRUE(a.is_pooled());
+  EXPECT_EQ(a, b);
+  EXPECT_EQ(flag, text(a));
+  EXPECT_EQ(1u, pool.size());
+
+  pool.retain(a);
+  pool.retain(b);
+  pool.release(a);
+  EXPECT_EQ(1u, pool.size());
+  pool.release(b);
+  EXPECT_EQ(0u, pool.size());
+
+  // The slot is reused, but never by an equal handle.
+  gfx::Glyph c = pool.intern("e\xcc\x81", 3);
+  EXPECT_EQ(a.index(), c.index());
+  EXPECT_NE(a, c);
+  EXPECT_EQ("e\xcc\x81", text(c));
+}
+
+TEST(GraphemePool, SharedReferences) {
+  gfx::GraphemePool pool;
+
+  std::string family = "\xF0\x9F\x91\xA8\xE2\x80\x8D\xF0\x9F\x91\xA9";
+  gfx::Glyph glyph = pool.intern(family.data(), family.size());
+  uint64_t version = pool.version();
+
+  // Interning it again finds the entry, without adding to the texts.
+  for (int i = 0; i < 3; i++) {
+    pool.retain(pool.intern(family.data(), family.size()));
+  }
+  EXPECT_EQ(version, pool.version());
+
+  pool.release(glyph);
+  pool.release(glyph);
+  ASSERT_EQ(1u, pool.size());
+  EXPECT_EQ(family, pool.pooled()[glyph.index()]);
+
+  pool.release(glyph);
+  EXPECT_EQ(0u, pool.size());
+  EXPECT_TRUE(pool.pooled()[glyph.index()].empty());
+}
+
+TEST(GraphemePool, DistinctClusters) {
+  gfx::GraphemePool pool;
+
+  std::string acute = "e\xcc\x81";
+  std::string grave = "e\xcc\x80";
+  gfx::Glyph a = pool.intern(acute.data(), acute.size());
+  gfx::Glyph b = pool.intern(grave.data(), grave.size());
+  EXPECT_NE(a.index(), b.index());
+  EXPECT_GT(pool.version(), 0u);
+
+  pool.retain(a);
+  pool.retain(b);
+
+  // Freeing one leaves the other where it was.
+  pool.release(a);
+  EXPECT_EQ(1u, pool.size());
+  EXPECT_EQ(grave, pool.pooled()[b.index()]);
+  EXPECT_EQ(b, pool.intern(grave.data(), grave.size()));
+
+  // Single code points, however long their encoding, are never pooled.
+  std::string emoji = "\xF0\x9F\x98\x82";
+  gfx::Glyph c = pool.intern(emoji.data(), emoji.size());
+  EXPECT_FALSE(c.is_pooled());
+  EXPECT_EQ(0x1F602u, c.code_point());
+
+  pool.release(b);
+  EXPECT_EQ(0u, pool.size());
+}
+
+TEST(GraphemePool, TextIsThePooledString) {
+  gfx::GraphemePool pool;
+  char utf8[4];
+
+  std::string flag = "\xF0\x9F\x87\xAC\xF0\x9F\x87\xA7";
+  gfx::Glyph glyph = pool.intern(flag.data(), flag.size());
+
+  // The view is read after the call, so it must point into the pool rather
+  // than at a copy.
+  std::string_view text = gfx::glyph_text(glyph, pool.pooled(), utf8);
+  EXPECT_EQ(pool.pooled()[glyph.index()].data(), text.data());
+  EXPECT_EQ(flag, text);
+
+  // A stale index reads as a blank.
+  gfx::Glyph stale = gfx::Glyph::pooled(1000, 0);
+  std::string_view blank = gfx::glyph_text(stale, pool.pooled(), utf8);
+  EXPECT_EQ(" ", blank);
+}
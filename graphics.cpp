@@ -1,4 +1,6 @@
 #include "graphics.hpp"
+#include "box_drawing.hpp"
+#include "celldiff.hpp"
 
 #include <SDL.h>
 #include <SDL_ttf.h>
@@ -10,6 +12,38 @@
 
 namespace gfx {
 
+namespace {
+
+// The number of cells the glyph at col covers, 2 for a wide glyph.
+int glyph_cells(const TermCell *row, int col, int cols) {
+  return col + 1 < cols && row[col + 1].glyph.is_empty() &&
+                 !row[col].glyph.is_empty()
+             ? 2
+             : 1;
+}
+
+// Whether the glyph is drawn in a run with its neighbours, shaped together:
+// everything drawn from the font, so ligatures and the joined forms of
+// scripts which need shaping can form. Runs are cut at blanks, and box
+// drawing is drawn a cell at a time.
+bool shapes(Glyph glyph) {
+  if (glyph.is_pooled()) {
+    return true;
+  }
+  uint32_t cp = glyph.code_point();
+  return cp > ' ' && cp != 0x7F && !is_box_drawing(cp);
+}
+
+// Whether the cell at col is part of a glyph which shapes.
+bool shapes(const TermCell *row, int col) {
+  if (col > 0 && row[col].glyph.is_empty()) {
+    col--;
+  }
+  return shapes(row[col].glyph);
+}
+
+} // namespace
+
 context::context() {
   if (SDL_Init(SDL_INIT_VIDEO) < 0) {
     d_error = true;
@@ -55,10 +89,13 @@ TermWin::~TermWin() {
 
 void TermWin::load_fonts(const FontSpec &spec) {
   tRender.load_fonts(ren, spec);
+  resolve_styles();
+
+  // The texture depends on the cell size.
+  resize_term(num_rows, num_cols);
 }
 
 void TermWin::resize_term(int rows, int cols) {
-  std::cout << "Size:" << rows << " rows by " << cols << " cols" << std::endl;
   if (tex != nullptr) {
     SDL_DestroyTexture(tex);
     std::cout << "Texture destroyed\n";
@@ -70,16 +107,14 @@ void TermWin::resize_term(int rows, int cols) {
   const int tex_width = num_cols * tRender.cell_width;
   const int tex_height = num_rows * tRender.cell_height;
 
-  normalScreen.resize(num_rows * num_cols);
-  alternativeScreen.resize(num_rows * num_cols);
+  drawn.assign(num_rows * num_cols, TermCell{});
+  all_dirty = true;
 
   tex = SDL_CreateTexture(ren, SDL_PIXELFORMAT_RGBA8888,
                           SDL_TEXTUREACCESS_TARGET, tex_width, tex_height);
 
   std::cout << "TermWin texture resize: " << tex_width << 'x' << tex_height
             << "\n";
-
-  clear_cells();
 }
 
 void TermWin::auto_resize_window() {
@@ -101,133 +136,331 @@ void TermWin::auto_resize_window() {
   SDL_SetWindowSize(win, texture_rect.w, texture_rect.h);
 }
 
-void TermWin::set_cell(int row, int col, TermCell cell) {
-  if (row < 0 || col < 0)
-    return;
-  if (row >= num_rows)
+void TermWin::redraw(const Snapshot &snapshot) {
+  if (snapshot.generation == drawn_generation && !all_dirty)
     return;
-  if (col >= num_cols)
+
+  if (snapshot.rows != num_rows || snapshot.cols != num_cols) {
+    resize_term(snapshot.rows, snapshot.cols);
+  }
+
+  if (tex == nullptr)
     return;
 
-  const size_t offset = row * num_cols + col;
+  if (snapshot.pooled_version != drawn_pooled_version) {
+    drawn_pooled = snapshot.pooled;
+    drawn_pooled_version = snapshot.pooled_version;
+  }
 
-  if (isNormalScreen) {
-    normalScreen[offset] = cell;
-  } else {
-    alternativeScreen[offset] = cell;
+  if (snapshot.styles_version != drawn_styles_version) {
+    drawn_styles = snapshot.styles;
+    drawn_styles_version = snapshot.styles_version;
+    resolve_styles();
   }
-}
 
-void TermWin::clear_cells(TermCell cell) {
+  SDL_SetRenderTarget(ren, tex);
+
+  if (all_dirty) {
+    clear();
+  }
+
+  // With no frames skipped, the damaged columns of each row are exact.
+  bool contiguous = snapshot.generation == drawn_generation + 1;
+
+  // Each cursor cell, old and new, is drawn once even if unchanged.
+  auto in_bounds = [&](int row, int col) {
+    return row >= 0 && row < num_rows && col >= 0 && col < num_cols;
+  };
+  bool old_cursor_drawn = !in_bounds(curs_row, curs_col);
+  bool new_cursor_drawn = !in_bounds(snapshot.curs_row, snapshot.curs_col);
+
+  // Queues the glyph covering the cell, returns the column after it. A
+  // glyph in a run is drawn with the rest of the run, as it is now and as it
+  // was drawn, since changing one glyph can change the shape of the others.
+  auto draw = [&](int row, int col) {
+    const TermCell *cells = snapshot.cells.data() + row * num_cols;
+    const TermCell *shadow = drawn.data() + row * num_cols;
+
+    // The second cell of a wide glyph is drawn along with the first.
+    if (col > 0 && cells[col].glyph.is_empty()) {
+      col--;
+    }
+    int end = col + glyph_cells(cells, col, num_cols);
+
+    auto joins = [&](int c) {
+      return shapes(cells, c) || shapes(shadow, c);
+    };
+    if (joins(col)) {
+      while (col > 0 && joins(col - 1)) {
+        col--;
+      }
+      if (col > 0 && cells[col].glyph.is_empty()) {
+        col--;
+      }
+      while (end < num_cols && joins(end)) {
+        end++;
+      }
+    }
+
+    int cursor_col = row == snapshot.curs_row ? snapshot.curs_col : -1;
+    end = draw_cells(row, col, end, cells, cursor_col);
+
+    std::copy(cells + col, cells + end, drawn.begin() + row * num_cols + col);
+
+    auto covers = [&](int r, int c) {
+      return r == row && c >= col && c < end;
+    };
+    old_cursor_drawn |= covers(curs_row, curs_col);
+    new_cursor_drawn |= covers(snapshot.curs_row, snapshot.curs_col);
+
+    return end;
+  };
+
+  // Draw the cells of the span which differ from what is drawn.
+  auto draw_span = [&](int row, int begin_col, int end_col) {
+    const TermCell *cells = snapshot.cells.data() + row * num_cols;
+    const TermCell *shadow = drawn.data() + row * num_cols;
+    const TermCell *end = cells + end_col;
+
+    for (const TermCell *c = cells + begin_col; c < end;) {
+      if (!all_dirty) {
+        c = find_changed(c, end, shadow + (c - cells));
+        if (c == end)
+          break;
+      }
+      c = cells + draw(row, static_cast<int>(c - cells));
+    }
+  };
+
   for (int row = 0; row < num_rows; row++) {
-    for (int col = 0; col < num_cols; col++) {
-      set_cell(row, col, cell);
+    const RowDamage &damage = snapshot.damage[row];
+
+    if (all_dirty || (damage.frame > drawn_generation && !contiguous)) {
+      draw_span(row, 0, num_cols);
+    } else if (damage.frame > drawn_generation) {
+      draw_span(row, damage.begin_col, damage.end_col);
     }
   }
-}
 
-void TermWin::clear_cells(int row, int begin_col, int end_col, TermCell cell) {
-  for (int col = begin_col; col < end_col && col < num_cols; col++) {
-    set_cell(row, col, cell);
+  if (!old_cursor_drawn) {
+    draw(curs_row, curs_col);
   }
-}
-
-void TermWin::clear_rows(int begin_row, int end_row, TermCell cell) {
-  for (int row = begin_row; row != end_row; row++) {
-    clear_cells(row, 0, num_cols, cell);
+  if (!new_cursor_drawn) {
+    draw(snapshot.curs_row, snapshot.curs_col);
   }
-}
 
-void TermWin::insert_cells(int row, int col, int number, TermCell cell) {
-  auto &cels = isNormalScreen ? normalScreen : alternativeScreen;
-  auto begin = cels.begin() + row * num_cols + col;
-  auto end = cels.begin() + (row + 1) * num_cols;
-  std::rotate(begin, end - number, end);
-  clear_cells(row, col, col + number, cell);
-}
+  tRender.flush(ren);
+  cleared = false;
 
-void TermWin::delete_cells(int row, int col, int number, TermCell cell) {
-  auto &cels = isNormalScreen ? normalScreen : alternativeScreen;
-  auto begin = cels.begin() + row * num_cols + col;
-  auto end = cels.begin() + (row + 1) * num_cols;
-  std::rotate(begin, begin + number, end);
-  clear_cells(row, num_cols - number, num_cols, cell);
-}
+  curs_row = snapshot.curs_row;
+  curs_col = snapshot.curs_col;
+  drawn_generation = snapshot.generation;
+  all_dirty = false;
 
-void TermWin::dirty() {
-  auto &cels = isNormalScreen ? normalScreen : alternativeScreen;
-  for (auto &c : cels) {
-    c.dirty() = true;
-  }
+  present();
 }
 
 void TermWin::redraw() {
-  auto &cels = isNormalScreen ? normalScreen : alternativeScreen;
   if (tex == nullptr)
     return;
 
   SDL_SetRenderTarget(ren, tex);
+  clear();
 
   for (int row = 0; row < num_rows; row++) {
-    for (int col = 0; col < num_cols; col++) {
-      // Cell locaiton.
-      int offset = row * num_cols + col;
-      const TermCell &cell = cels[offset].value();
-      bool dirty = cels[offset].dirty();
-      int cell_top_y = row * tRender.cell_height;
-      int cell_left_x = col * tRender.cell_width;
-
-      // Cell content.
-      const char *glyph = cell.glyph.c_str();
-
-      // Cell color.
-      SDL_Color fg, bg;
-      fg.r = static_cast<uint8_t>((cell.fg_col & 0xFF000000) >> 24);
-      fg.g = static_cast<uint8_t>((cell.fg_col & 0x00FF0000) >> 16);
-      fg.b = static_cast<uint8_t>((cell.fg_col & 0x0000FF00) >> 8);
-      fg.a = 0xFF;
-      bg.r = static_cast<uint8_t>((cell.bg_col & 0xFF000000) >> 24);
-      bg.g = static_cast<uint8_t>((cell.bg_col & 0x00FF0000) >> 16);
-      bg.b = static_cast<uint8_t>((cell.bg_col & 0x0000FF00) >> 8);
-      bg.a = 0xFF;
-
-      // Cursor.
-      bool is_cursor = row == curs_row && col == curs_col;
-      int curs_height = 2;
-
-      // Rectangle for the cursor.
-      SDL_Rect curs_rect;
-      curs_rect.w = tRender.cell_width;
-      curs_rect.h = curs_height;
-      curs_rect.x = cell_left_x;
-      curs_rect.y = cell_top_y + tRender.cell_height - curs_height;
-
-      // Cell font;
-      TTF_Font *font = tRender.get_font(cell.bold, cell.italic);
-
-      // And now, actual drawing.
-
-      // Don't draw an unchanged cell, ..., unless it's the cursor.
-      if (!dirty && !is_cursor)
-        continue;
-
-      if (cell.reverse) {
-        std::swap(fg, bg);
-      }
+    draw_cells(row, 0, num_cols, drawn.data() + row * num_cols,
+               row == curs_row ? curs_col : -1);
+  }
+
+  tRender.flush(ren);
+  cleared = false;
+
+  present();
+}
+
+void TermWin::clear() {
+  const SDL_Color &bg = draw_styles.front().bg;
+  SDL_SetRenderDrawColor(ren, bg.r, bg.g, bg.b, 0xFF);
+  SDL_RenderClear(ren);
+  cleared = true;
+}
 
-      tRender.draw_character(ren, font, glyph, fg, bg, cell_top_y, cell_left_x);
+void TermWin::resolve_styles() {
+  if (drawn_styles.empty()) {
+    drawn_styles.emplace_back();
+  }
 
-      if (is_cursor) {
-        // Begin draw cursor.
-        SDL_SetRenderDrawColor(ren, fg.r, fg.g, fg.b, 0xFF);
-        SDL_RenderFillRect(ren, &curs_rect);
-        cels[offset].dirty() = true;
+  auto to_sdl = [](uint32_t colour) {
+    SDL_Color c;
+    c.r = static_cast<uint8_t>((colour & 0xFF000000) >> 24);
+    c.g = static_cast<uint8_t>((colour & 0x00FF0000) >> 16);
+    c.b = static_cast<uint8_t>((colour & 0x0000FF00) >> 8);
+    c.a = 0xFF;
+    return c;
+  };
+
+  using A = Style::Attr;
+
+  draw_styles.resize(drawn_styles.size());
+  for (size_t i = 0; i < drawn_styles.size(); i++) {
+    const Style &style = drawn_styles[i];
+    DrawStyle &draw = draw_styles[i];
+
+    draw.fg = to_sdl(style.fg_col);
+    draw.bg = to_sdl(style.bg_col);
+    draw.font = tRender.get_font(style.has(A::BOLD), style.has(A::ITALIC));
+
+    draw.underline = style.has(A::UNDERLINE);
+    draw.dunderline = style.has(A::DUNDERLINE);
+    draw.strike = style.has(A::STRIKE);
+    draw.overline = style.has(A::OVERLINE);
+
+    if (style.has(A::REVERSE)) {
+      std::swap(draw.fg, draw.bg);
+    }
+  }
+}
+
+int TermWin::draw_cells(int row, int begin, int end, const TermCell *cells,
+                       int cursor_col) {
+  // The run being gathered, of glyphs which shape, in one style.
+  std::string run;
+  std::vector<RunCell> run_glyphs;
+  int run_col = 0;
+  int run_cells = 0;
+  uint32_t run_style = 0;
+
+  auto draw_run = [&] {
+    if (run_cells > 0) {
+      size_t index = StyleTable::index(run_style);
+      const DrawStyle &style =
+          draw_styles[index < draw_styles.size() ? index : 0];
+      int top = row * tRender.cell_height;
+      int left = run_col * tRender.cell_width;
+      // A glyph on its own has nothing to shape with.
+      if (run_glyphs.size() == 1) {
+        tRender.draw_character(style.font, run, style.fg, top, left);
       } else {
-        cels[offset].dirty() = false;
+        tRender.draw_run(style.font, run, run_glyphs, run_cells, style.fg,
+                         top, left);
       }
     }
+    run.clear();
+    run_glyphs.clear();
+    run_cells = 0;
+  };
+
+  int col = begin;
+  while (col < end) {
+    const TermCell &cell = cells[col];
+    int width = glyph_cells(cells, col, num_cols);
+    bool is_cursor = cursor_col >= col && cursor_col < col + width;
+
+    bool shaped = shapes(cell.glyph);
+    if (!shaped || cell.style != run_style ||
+        run_cells + width > TextRenderer::max_run_cells) {
+      draw_run();
+    }
+
+    draw_cell(row, col, cell, width, is_cursor, shaped);
+
+    if (shaped) {
+      if (run_cells == 0) {
+        run_col = col;
+        run_style = cell.style;
+      }
+      char utf8[4];
+      run_glyphs.push_back(
+          RunCell{static_cast<int>(run.size()), col - run_col});
+      run += glyph_text(cell.glyph, drawn_pooled, utf8);
+      run_cells += width;
+    }
+    col += width;
+  }
+  draw_run();
+
+  return col;
+}
+
+void TermWin::draw_cell(int row, int col, const TermCell &cell, int width,
+                        bool is_cursor, bool in_run) {
+  // Cell locaiton.
+  int cell_top_y = row * tRender.cell_height;
+  int cell_left_x = col * tRender.cell_width;
+  int cell_w = tRender.cell_width * width;
+
+  // Cell content, the second cell of a wide glyph has none.
+  char utf8[4];
+  std::string_view glyph = glyph_text(cell.glyph, drawn_pooled, utf8);
+  if (glyph.empty()) {
+    glyph = " ";
+  }
+
+  // Cell color and font.
+  size_t index = StyleTable::index(cell.style);
+  const DrawStyle &style =
+      draw_styles[index < draw_styles.size() ? index : 0];
+
+  bool decorated =
+      style.underline || style.dunderline || style.strike || style.overline;
+
+  // A blank cell on the default background is already drawn, after a clear.
+  const SDL_Color &default_bg = draw_styles.front().bg;
+  if (cleared && glyph == " " && !decorated && !is_cursor &&
+      style.bg.r == default_bg.r && style.bg.g == default_bg.g &&
+      style.bg.b == default_bg.b) {
+    return;
   }
 
+  // And now, actual drawing.
+
+  tRender.draw_background(
+      SDL_Rect{cell_left_x, cell_top_y, cell_w, tRender.cell_height},
+      style.bg);
+
+  // A glyph in a run is drawn with the run, see draw_cells.
+  if (!in_run) {
+    tRender.draw_character(style.font, glyph, style.fg, cell_top_y,
+                           cell_left_x);
+  }
+
+  // Decorations, as lines across the cell in the foreground colour.
+  int line = std::max(1, tRender.cell_height / 16);
+  auto draw_line = [&](int y) {
+    y = std::min(std::max(y, 0), tRender.cell_height - line);
+    tRender.draw_rect(SDL_Rect{cell_left_x, cell_top_y + y, cell_w, line},
+                      style.fg);
+  };
+
+  int underline_y = tRender.font_ascent + line;
+  if (style.underline || style.dunderline) {
+    draw_line(underline_y);
+  }
+  if (style.dunderline) {
+    draw_line(underline_y + 2 * line);
+  }
+  if (style.strike) {
+    draw_line(tRender.font_ascent * 2 / 3);
+  }
+  if (style.overline) {
+    draw_line(0);
+  }
+
+  if (is_cursor) {
+    // Begin draw cursor.
+    int curs_height = 2;
+
+    SDL_Rect curs_rect;
+    curs_rect.w = cell_w;
+    curs_rect.h = curs_height;
+    curs_rect.x = cell_left_x;
+    curs_rect.y = cell_top_y + tRender.cell_height - curs_height;
+
+    tRender.draw_rect(curs_rect, style.fg);
+  }
+}
+
+void TermWin::present() {
   SDL_Rect screen_rect;
   screen_rect.x = screen_rect.y = 0;
   SDL_GetWindowSize(win, &screen_rect.w, &screen_rect.h);
@@ -243,55 +476,7 @@ void TermWin::redraw() {
   SDL_RenderPresent(ren);
 }
 
-void TermWin::move_cursor(int row, int col) {
-  curs_row = row;
-  curs_col = col;
-}
-
-// range is: [begin_row, end_row)
-void TermWin::scroll(int begin_row, int end_row, Direction d, int amount) {
-  auto &cels = isNormalScreen ? normalScreen : alternativeScreen;
-
-#ifdef PEACHTERM_IS_VERBOSE
-  std::cout << "Scrolling rows [" << begin_row << ", " << end_row << ") "
-            << (d == Direction::UP ? "UP" : "DOWN") << " by " << amount << "\n";
-#endif
-
-  auto row_it = [&](int row) { return cels.begin() + num_cols * row; };
-
-  auto mid = std::rotate(row_it(begin_row),
-                         d == Direction::UP ? row_it(begin_row + amount)
-                                            : row_it(end_row - amount),
-                         row_it(end_row));
-
-  TermCell clear;
-
-  if (d == Direction::UP) {
-    // blank lines are at the end.
-    // clear mid - end.
-    auto end = row_it(end_row);
-    for (auto b = mid; b != end; b += num_cols) {
-      if (scrollback) {
-        scrollback->add_row_to_history(b, b + num_cols);
-      }
-    }
-    for (auto b = mid; b != end; b++) {
-      *b = clear;
-    }
-  } else {
-    // blank lines are at the start.
-    // clear start - mid.
-    auto begin = row_it(begin_row);
-    for (auto b = begin; b != mid; b += num_cols) {
-      if (scrollback) {
-        scrollback->add_row_to_history(b, b + num_cols);
-      }
-    }
-    for (auto b = begin; b != mid; b++) {
-      *b = clear;
-    }
-  }
-}
+bool TermWin::idle() { return tRender.prewarm(ren); }
 
 std::pair<int, int> TermWin::cell_size() const {
   return tRender.cell_size();
@@ -301,11 +486,15 @@ void TermWin::set_window_title(std::string_view data) {
   SDL_SetWindowTitle(win, data.data());
 }
 
+void TermWin::set_clipboard(const std::string &text) {
+  SDL_SetClipboardText(text.c_str());
+}
+
 void TermWin::stat_callback() {
   tRender.dump_cache_stats();
 }
 
 void TermWin::dump_state_callback() {
-  tRender.dump_cache_to_disk(ren);
+  tRender.dump_cache_to_disk();
 }
 } // namespace gfx
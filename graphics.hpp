@@ -5,9 +5,8 @@
 #include <memory>
 #include <string>
 
-#include "util.hpp"
+#include "grid.hpp"
 #include "termcell.hpp"
-#include "termhistory.hpp"
 #include "text_renderer.h"
 
 struct SDL_Window;
@@ -33,8 +32,6 @@ public:
   context &operator=(const context &) = delete;
 };
 
-enum class Direction { UP, DOWN };
-
 class TermWin {
   SDL_Window *win = nullptr;
   SDL_Renderer *ren = nullptr;
@@ -42,12 +39,25 @@ class TermWin {
 
   TextRenderer tRender;
 
-  bool isNormalScreen = true;
-
-  std::vector<util::DirtyTracker<TermCell>> normalScreen;
-  std::vector<util::DirtyTracker<TermCell>> alternativeScreen;
-
-  std::shared_ptr<TermHistory> scrollback;
+  // What is currently drawn on tex, a shadow of the screen. Damaged rows of
+  // each new snapshot are diffed against it, to redraw only changed cells.
+  std::vector<TermCell> drawn;
+  std::vector<std::string> drawn_pooled;
+  uint64_t drawn_pooled_version = 0;
+  std::vector<Style> drawn_styles;
+  uint64_t drawn_styles_version = 0;
+  uint64_t drawn_generation = 0;
+
+  struct DrawStyle {
+    // A style resolved for drawing, with reverse video applied.
+    SDL_Color fg;
+    SDL_Color bg;
+    TTF_Font *font;
+    bool underline, dunderline, strike, overline;
+  };
+  std::vector<DrawStyle> draw_styles; // by style index
+  bool all_dirty = true;
+  bool cleared = false; // tex was cleared to the default background this frame
 
   int num_rows;
   int num_cols;
@@ -62,32 +72,38 @@ public:
   TermWin(const TermWin &) = delete;
   TermWin &operator=(const TermWin &) = delete;
 
-  void set_scrollback(std::shared_ptr<TermHistory> hist_sp);
   void load_fonts(const FontSpec&);
-  // resize grid
-  void resize_term(int rows, int cols);
   // resize window
   void auto_resize_window();
-  void set_cell(int row, int col, TermCell cell);
-  void clear_cells(TermCell cell = {});
-  void clear_cells(int row, int begin_col, int end_col, TermCell cell = {});
-  void clear_rows(int begin_row, int end_row, TermCell cell = {});
-  void clear_screen();
-  void insert_cells(int row, int col, int number, TermCell cell = {});
-  void delete_cells(int row, int col, int number, TermCell cell = {});
+  void redraw(const Snapshot &snapshot);
+  // Draw the cells of the snapshot which have changed since the last one.
   void redraw();
-  void dirty();
-  void move_cursor(int row, int col);
-  void scroll(int begin_row, int end_row, Direction d, int amount);
-  bool& screen_mode_normal();
+  // Draw every cell of the last snapshot again.
+  bool idle();
+  // Do a little background work, true while there's more to do.
   std::pair<int, int> cell_size() const;
   void set_window_title(std::string_view);
+  void set_clipboard(const std::string &);
   void stat_callback();
   void dump_state_callback();
-};
 
-inline bool& TermWin::screen_mode_normal() { return isNormalScreen; }
-inline void TermWin::clear_screen() { clear_rows(0, num_rows); }
-inline void TermWin::set_scrollback(std::shared_ptr<TermHistory> hist_sp) { this->scrollback = hist_sp; }
+private:
+  void resize_term(int rows, int cols);
+  // resize the texture, for a grid of the given size
+  void resolve_styles();
+  // Compute the draw style of each of drawn_styles, once per style.
+  void clear();
+  // Fill tex with the default background, so blank cells can be skipped.
+  int draw_cells(int row, int begin, int end, const TermCell *cells,
+                 int cursor_col);
+  // Queue the cells of row from begin to end, gathering glyphs which shape
+  // into runs. cells is the whole row. Returns the column after the last
+  // cell, past end if a wide glyph straddles it.
+  void draw_cell(int row, int col, const TermCell &cell, int width,
+                 bool is_cursor, bool in_run);
+  // Queue the background and glyph of cell, covering width cells from col.
+  // The glyph is left to the run if it's drawn in one.
+  void present();
+};
 
 } // namespace gfx
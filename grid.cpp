@@ -0,0 +1,459 @@
+#include "grid.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <iterator>
+
+namespace gfx {
+
+namespace {
+
+bool is_blank(const Grid::Line &line) {
+  return !line.wrapped &&
+         std::all_of(line.cells.begin(), line.cells.end(),
+                     [](const TermCell &c) { return c == TermCell{}; });
+}
+
+// Rewrap lines to cols, joining those continued by a wrap. Trailing blanks of
+// each logical line are dropped, a wide glyph is never split. The cursor,
+// (curs_line, curs_col), is moved to the same cell.
+std::vector<Grid::Line> rewrap(std::vector<Grid::Line> &lines, int cols,
+                               int &curs_line, int &curs_col) {
+  std::vector<Grid::Line> out;
+  int new_line = -1;
+  int new_col = 0;
+
+  Grid::Line row;
+  int pos = 0;
+
+  auto start_row = [&] {
+    row.cells.assign(cols, TermCell{});
+    row.wrapped = false;
+    pos = 0;
+  };
+
+  size_t i = 0;
+  while (i < lines.size()) {
+    size_t j = i;
+    while (j + 1 < lines.size() && lines[j].wrapped) {
+      j++;
+    }
+
+    // The cursor's offset in the logical line [i, j], if it's on it.
+    const size_t none = static_cast<size_t>(-1);
+    size_t cursor = none;
+    size_t total = 0;
+    for (size_t k = i; k <= j; k++) {
+      if (static_cast<int>(k) == curs_line) {
+        cursor = total + curs_col;
+      }
+      total += lines[k].cells.size();
+    }
+
+    const auto &last = lines[j].cells;
+    auto content = std::find_if(last.rbegin(), last.rend(),
+                                [](const TermCell &c) { return c != TermCell{}; });
+    size_t end = total - (content - last.rbegin());
+    if (cursor != none) {
+      end = std::max(end, std::min(cursor + 1, total));
+    }
+
+    start_row();
+
+    size_t offset = 0;
+    for (size_t k = i; k <= j && offset < end; k++) {
+      const auto &cells = lines[k].cells;
+      for (size_t c = 0; c < cells.size() && offset < end; c++, offset++) {
+        bool wide = c + 1 < cells.size() && cells[c + 1].glyph.is_empty() &&
+                    !cells[c].glyph.is_empty();
+
+        if (pos == cols || (wide && pos + 1 == cols && cols > 1)) {
+          row.wrapped = true;
+          out.push_back(std::move(row));
+          start_row();
+        }
+
+        if (offset == cursor) {
+          new_line = static_cast<int>(out.size());
+          new_col = pos;
+        }
+
+        row.cells[pos++] = cells[c];
+      }
+    }
+
+    if (cursor != none && cursor >= end) {
+      // Just past the end, waiting to wrap.
+      new_line = static_cast<int>(out.size());
+      new_col = pos;
+    }
+
+    out.push_back(std::move(row));
+    i = j + 1;
+  }
+
+  curs_line = new_line;
+  curs_col = new_col;
+  return out;
+}
+
+} // namespace
+
+Grid::Grid(int rows, int cols) { resize(rows, cols); }
+
+void Grid::resize(int rows, int cols) {
+  std::cout << "Size:" << rows << " rows by " << cols << " cols" << std::endl;
+
+  std::vector<std::vector<TermCell>> old_pool = std::move(row_pool);
+  std::vector<uint8_t> old_wrapped = std::move(row_wrapped);
+  std::vector<uint32_t> old_normal = std::move(normalScreen);
+  std::vector<uint32_t> old_alternative = std::move(alternativeScreen);
+  const int old_rows = old_pool.empty() ? 0 : num_rows;
+  const int old_cols = old_pool.empty() ? 0 : num_cols;
+
+  num_rows = rows;
+  num_cols = cols;
+
+  // Rows [0, rows) are the normal screen's, [rows, 2 * rows) the alternative.
+  row_pool.assign(size_t{2} * num_rows, std::vector<TermCell>(num_cols));
+  row_wrapped.assign(size_t{2} * num_rows, 0);
+  normalScreen.resize(num_rows);
+  alternativeScreen.resize(num_rows);
+  for (int row = 0; row < num_rows; row++) {
+    normalScreen[row] = row;
+    alternativeScreen[row] = num_rows + row;
+  }
+
+  damage.resize(rows, cols);
+  row_damage.assign(rows, RowDamage{});
+
+  // The cells move to their new places, their references with them.
+  std::vector<Line> lines{std::make_move_iterator(history.begin()),
+                          std::make_move_iterator(history.end())};
+  history.clear();
+
+  int curs_line = isNormalScreen ? static_cast<int>(lines.size()) + curs_row : -1;
+
+  for (int row = 0; row < old_rows; row++) {
+    lines.push_back(Line{std::move(old_pool[old_normal[row]]),
+                         old_wrapped[old_normal[row]] != 0});
+  }
+
+  reflow(std::move(lines), curs_line);
+
+  // The alternative screen is cropped, its programs redraw on a resize.
+  for (int row = 0; row < old_rows; row++) {
+    const TermCell *old_cells = old_pool[old_alternative[row]].data();
+
+    if (row >= num_rows) {
+      release(old_cells, old_cells + old_cols);
+      continue;
+    }
+
+    const int keep = std::min(old_cols, num_cols);
+    std::copy(old_cells, old_cells + keep,
+              row_pool[alternativeScreen[row]].begin());
+    release(old_cells + keep, old_cells + old_cols);
+  }
+
+  if (!isNormalScreen) {
+    curs_row = std::min(curs_row, num_rows - 1);
+    curs_col = std::min(curs_col, num_cols - 1);
+  }
+}
+
+void Grid::reflow(std::vector<Line> lines, int curs_line) {
+  int new_col = curs_col;
+  std::vector<Line> out = rewrap(lines, num_cols, curs_line, new_col);
+
+  // Blank lines below the cursor go, rather than push lines off the screen.
+  while (!out.empty() && static_cast<int>(out.size()) - 1 > curs_line &&
+         is_blank(out.back())) {
+    out.pop_back();
+  }
+
+  const int total = static_cast<int>(out.size());
+
+  // The last screenful, moved up if need be to keep the cursor on it.
+  int top = std::max(0, total - num_rows);
+  if (curs_line >= 0) {
+    top = std::min(top, curs_line);
+  }
+
+  for (int k = 0; k < top; k++) {
+    history.push_back(std::move(out[k]));
+  }
+  while (history.size() > history_limit) {
+    const auto &cells = history.front().cells;
+    release(cells.data(), cells.data() + cells.size());
+    history.pop_front();
+  }
+
+  for (int k = top; k < total; k++) {
+    const int row = k - top;
+    const auto &cells = out[k].cells;
+
+    if (row >= num_rows) {
+      release(cells.data(), cells.data() + cells.size());
+      continue;
+    }
+
+    const uint32_t handle = normalScreen[row];
+    std::copy(cells.begin(), cells.end(), row_pool[handle].begin());
+    row_wrapped[handle] = out[k].wrapped;
+  }
+
+  if (curs_line >= 0) {
+    curs_row = curs_line - top;
+    curs_col = new_col;
+  }
+}
+
+void Grid::release(const TermCell *begin, const TermCell *end) {
+  for (auto cell = begin; cell != end; ++cell) {
+    graphemes.release(cell->glyph);
+    styles.release(cell->style);
+  }
+}
+
+uint32_t Grid::set_pen(const Style &style) {
+  uint32_t id = styles.intern(style);
+  styles.retain(id);
+  styles.release(pen);
+  pen = id;
+  return id;
+}
+
+void Grid::set_cell(int row, int col, TermCell cell) {
+  if (row < 0 || col < 0)
+    return;
+  if (row >= num_rows)
+    return;
+  if (col >= num_cols)
+    return;
+
+  int begin = col;
+  int end = col + 1;
+  break_wide(row, begin, end, cell.glyph.is_empty());
+
+  assign(row_cells(row)[col], cell);
+  damage.mark(row, begin, end);
+}
+
+int Grid::put_text(int row, int col, const char *text, size_t length,
+                   uint32_t style) {
+  if (row < 0 || col < 0 || row >= num_rows || col >= num_cols)
+    return 0;
+
+  const int count =
+      static_cast<int>(std::min(length, static_cast<size_t>(num_cols - col)));
+
+  TermCell *cells = row_cells(row) + col;
+  int begin = col;
+  int end = col + count;
+  break_wide(row, begin, end);
+
+  // Retained first, so releasing a cell of the same style can't free it.
+  styles.retain(style, count);
+
+  for (int i = 0; i < count; i++) {
+    graphemes.release(cells[i].glyph);
+    styles.release(cells[i].style);
+    cells[i].glyph = Glyph::code_point(static_cast<uint8_t>(text[i]));
+    cells[i].style = style;
+  }
+
+  damage.mark(row, begin, end);
+  return count;
+}
+
+void Grid::break_wide(int row, int &begin, int &end, bool keep_lead) {
+  TermCell *line = row_cells(row);
+
+  // The glyph to the left if the range starts on its padding, the padding to
+  // the right if the range ends on its glyph.
+  if (!keep_lead && begin > 0 && line[begin].glyph.is_empty()) {
+    graphemes.release(line[begin - 1].glyph);
+    line[begin - 1].glyph = Glyph{};
+    begin--;
+  }
+  if (end < num_cols && line[end].glyph.is_empty()) {
+    line[end].glyph = Glyph{};
+    end++;
+  }
+}
+
+void Grid::clear_cells(TermCell cell) {
+  for (int row = 0; row < num_rows; row++) {
+    for (int col = 0; col < num_cols; col++) {
+      set_cell(row, col, cell);
+    }
+  }
+}
+
+void Grid::clear_cells(int row, int begin_col, int end_col, TermCell cell) {
+  for (int col = begin_col; col < end_col && col < num_cols; col++) {
+    set_cell(row, col, cell);
+  }
+}
+
+void Grid::clear_rows(int begin_row, int end_row, TermCell cell) {
+  for (int row = begin_row; row != end_row; row++) {
+    clear_cells(row, 0, num_cols, cell);
+    set_wrapped(row, false);
+  }
+}
+
+void Grid::insert_cells(int row, int col, int number, TermCell cell) {
+  if (row < 0 || col < 0 || row >= num_rows || col >= num_cols)
+    return;
+
+  // No more than the cells from col to the end of the row.
+  number = std::min(number, num_cols - col);
+  if (number <= 0)
+    return;
+
+  auto begin = row_cells(row) + col;
+  auto end = row_cells(row) + num_cols;
+  std::rotate(begin, end - number, end);
+  damage.mark(row, col, num_cols);
+  clear_cells(row, col, col + number, cell);
+}
+
+void Grid::delete_cells(int row, int col, int number, TermCell cell) {
+  if (row < 0 || col < 0 || row >= num_rows || col >= num_cols)
+    return;
+
+  // No more than the cells from col to the end of the row.
+  number = std::min(number, num_cols - col);
+  if (number <= 0)
+    return;
+
+  auto begin = row_cells(row) + col;
+  auto end = row_cells(row) + num_cols;
+  std::rotate(begin, begin + number, end);
+  damage.mark(row, col, num_cols);
+  clear_cells(row, num_cols - number, num_cols, cell);
+}
+
+void Grid::move_cursor(int row, int col) {
+  curs_row = row;
+  curs_col = col;
+}
+
+// range is: [begin_row, end_row)
+void Grid::scroll(int begin_row, int end_row, Direction d, int amount) {
+  auto &handles = screen();
+
+  begin_row = std::max(begin_row, 0);
+  end_row = std::min(end_row, num_rows);
+  // Scrolling by the whole region or more just clears it.
+  amount = std::min(amount, end_row - begin_row);
+  if (amount <= 0) {
+    return;
+  }
+
+#ifdef PEACHTERM_IS_VERBOSE
+  std::cout << "Scrolling rows [" << begin_row << ", " << end_row << ") "
+            << (d == Direction::UP ? "UP" : "DOWN") << " by " << amount << "\n";
+#endif
+
+  auto row_it = [&](int row) { return handles.begin() + row; };
+
+  // Only the handles move, the rows scrolled out are blanked and reused for
+  // the rows scrolled in.
+  auto mid = std::rotate(row_it(begin_row),
+                         d == Direction::UP ? row_it(begin_row + amount)
+                                            : row_it(end_row - amount),
+                         row_it(end_row));
+
+  damage.mark_rows(begin_row, end_row);
+
+  // UP: blank lines are at the end, [mid, end).
+  // DOWN: blank lines are at the start, [begin, mid).
+  auto begin = d == Direction::UP ? mid : row_it(begin_row);
+  auto end = d == Direction::UP ? row_it(end_row) : mid;
+
+  // Only rows scrolled off the top of the normal screen are kept in history,
+  // those leaving a scroll region or the alternative screen are dropped.
+  const bool keep = isNormalScreen && d == Direction::UP && begin_row == 0;
+
+  for (auto h = begin; h != end; ++h) {
+    if (!keep) {
+      clear_row(*h);
+      continue;
+    }
+
+    auto &cells = row_pool[*h];
+    if (scrollback) {
+      scrollback->add_row_to_history(cells.begin(), cells.end(),
+                                     graphemes.pooled());
+    }
+
+    // The line swaps its blank storage for the row, taking over the
+    // references of the cells. The oldest line's storage is reused once
+    // history is full.
+    Line line;
+    if (history.size() == history_limit) {
+      line = std::move(history.front());
+      history.pop_front();
+      release(line.cells.data(), line.cells.data() + line.cells.size());
+    }
+    line.cells.assign(num_cols, TermCell{});
+    line.cells.swap(cells);
+    line.wrapped = row_wrapped[*h];
+    history.push_back(std::move(line));
+
+    row_wrapped[*h] = false;
+  }
+}
+
+void Grid::clear_row(uint32_t handle) {
+  auto &cells = row_pool[handle];
+  release(cells.data(), cells.data() + cells.size());
+  std::fill(cells.begin(), cells.end(), TermCell{});
+  row_wrapped[handle] = false;
+}
+
+void Grid::snapshot(Snapshot &out) {
+  const auto &handles = screen();
+
+  damage.for_each([&](int row, int begin_col, int end_col) {
+    row_damage[row] = RowDamage{frame, begin_col, end_col};
+  });
+  damage.clear();
+
+  // out holds the frame it was last filled with, copy the rows changed since.
+  bool whole = out.rows != num_rows || out.cols != num_cols;
+
+  out.rows = num_rows;
+  out.cols = num_cols;
+  out.curs_row = curs_row;
+  out.curs_col = curs_col;
+
+  if (whole) {
+    out.cells.resize(static_cast<size_t>(num_rows) * num_cols);
+  }
+
+  for (int row = 0; row < num_rows; row++) {
+    if (whole || row_damage[row].frame > out.generation) {
+      const auto &cells = row_pool[handles[row]];
+      std::copy(cells.begin(), cells.end(), out.cells.begin() + row * num_cols);
+    }
+  }
+
+  out.damage = row_damage;
+  out.generation = frame++;
+
+  if (out.pooled_version != graphemes.version()) {
+    out.pooled = graphemes.pooled();
+    out.pooled_version = graphemes.version();
+  }
+
+  if (out.styles_version != styles.version()) {
+    out.styles = styles.styles();
+    out.styles_version = styles.version();
+  }
+}
+
+} // namespace gfx
@@ -0,0 +1,183 @@
+#pragma once
+#include <deque>
+#include <memory>
+#include <stdint.h>
+#include <utility>
+#include <vector>
+
+#include "grapheme_pool.hpp"
+#include "style_table.hpp"
+#include "termcell.hpp"
+#include "termhistory.hpp"
+#include "util.hpp"
+
+namespace gfx {
+
+enum class Direction { UP, DOWN };
+
+struct RowDamage {
+  uint64_t frame = 0; // the last frame the row changed in
+  int begin_col = 0;  // the columns changed in that frame
+  int end_col = 0;
+};
+
+struct Snapshot {
+  // A copy of the visible screen, handed from the parser thread to the
+  // renderer. Each snapshot is a new frame, its generation.
+  uint64_t generation = 0;
+
+  int rows = 0;
+  int cols = 0;
+
+  int curs_row = 0;
+  int curs_col = 0;
+
+  std::vector<TermCell> cells;
+  std::vector<RowDamage> damage; // by row
+
+  // The text of the pooled glyphs in cells, copied only when it changes.
+  std::vector<std::string> pooled;
+  uint64_t pooled_version = 0;
+
+  // The styles of the cells by index, likewise copied only when they change.
+  std::vector<Style> styles;
+  uint64_t styles_version = 0;
+};
+
+class Grid {
+  // The cells of the normal and alternative screens. Owned by the parser
+  // thread, the renderer only ever sees snapshots of it.
+  bool isNormalScreen = true;
+
+  // Each screen is a list of handles to rows in the pool, so scrolling
+  // moves handles rather than cells.
+  std::vector<std::vector<TermCell>> row_pool;
+  std::vector<uint8_t> row_wrapped; // by handle, the row continues below
+  std::vector<uint32_t> normalScreen;
+  std::vector<uint32_t> alternativeScreen;
+
+public:
+  struct Line {
+    std::vector<TermCell> cells;
+    bool wrapped = false;
+  };
+
+private:
+  // Rows scrolled off the top of the normal screen, oldest first. Kept to
+  // rewrap them along with the screen on resize.
+  std::deque<Line> history;
+  static constexpr size_t history_limit = 10000;
+
+  // Rows changed since the last snapshot, and the frame each row last
+  // changed in.
+  util::Damage damage;
+  std::vector<RowDamage> row_damage;
+  uint64_t frame = 1;
+
+  GraphemePool graphemes;
+  StyleTable styles;
+  uint32_t pen = 0;
+
+  std::shared_ptr<TermHistory> scrollback;
+
+  int num_rows;
+  int num_cols;
+
+  int curs_row = 0;
+  int curs_col = 0;
+
+public:
+  Grid(int rows, int cols);
+
+  void set_scrollback(std::shared_ptr<TermHistory> hist_sp);
+  Glyph intern(const char *text, size_t length);
+  void discard(Glyph glyph);
+  // Free an interned glyph no cell took, see GraphemePool::discard.
+  uint32_t set_pen(const Style &style);
+  // The id of style, kept alive until the pen changes again.
+  void resize(int rows, int cols);
+  // Resize the grid. The normal screen and history are rewrapped to the new
+  // width, keeping the cursor on the same cell.
+  std::pair<int, int> cursor() const;
+  // The cursor's (row, col), as moved by resize.
+  void set_wrapped(int row, bool wrapped);
+  // Mark the row as continuing on the next, by an automatic wrap.
+  void set_cell(int row, int col, TermCell cell);
+  int put_text(int row, int col, const char *text, size_t length,
+               uint32_t style);
+  // Write single byte glyphs from col, in one pass. Stops at the end of the
+  // row, returns the number written. A wide glyph the run covers half of is
+  // blanked.
+  void clear_cells(TermCell cell = {});
+  void clear_cells(int row, int begin_col, int end_col, TermCell cell = {});
+  void clear_rows(int begin_row, int end_row, TermCell cell = {});
+  void clear_screen();
+  void insert_cells(int row, int col, int number, TermCell cell = {});
+  void delete_cells(int row, int col, int number, TermCell cell = {});
+  void move_cursor(int row, int col);
+  void scroll(int begin_row, int end_row, Direction d, int amount);
+  void screen_mode_normal(bool normal);
+
+  void snapshot(Snapshot &out);
+  // Copy the visible screen and cursor into out, as the next frame. Only the
+  // rows changed since out was last filled are copied.
+
+private:
+  std::vector<uint32_t> &screen();
+  const std::vector<uint32_t> &screen() const;
+  TermCell *row_cells(int row);
+  // The first cell of the row on the current screen.
+  void assign(TermCell &to, const TermCell &from);
+  // Every write of a cell goes through here, to count glyph references.
+  void clear_row(uint32_t handle);
+  // Blank a whole row in place.
+  void break_wide(int row, int &begin, int &end, bool keep_lead = false);
+  // Before cells [begin, end) of row are overwritten, blank the other half
+  // of a wide glyph they cover only half of, widening the range to take it
+  // in. keep_lead leaves the glyph left of begin, for writing its padding.
+  void release(const TermCell *begin, const TermCell *end);
+  void reflow(std::vector<Line> lines, int curs_line);
+  // Rewrap lines into history and the normal screen. curs_line is the line
+  // the cursor is on, or -1 if it's on the alternative screen.
+};
+
+inline void Grid::screen_mode_normal(bool normal) {
+  if (isNormalScreen != normal) {
+    isNormalScreen = normal;
+    damage.mark_all();
+  }
+}
+inline void Grid::clear_screen() { clear_rows(0, num_rows); }
+inline std::pair<int, int> Grid::cursor() const {
+  return {curs_row, curs_col};
+}
+inline void Grid::set_wrapped(int row, bool wrapped) {
+  if (row >= 0 && row < num_rows) {
+    row_wrapped[screen()[row]] = wrapped;
+  }
+}
+inline void Grid::set_scrollback(std::shared_ptr<TermHistory> hist_sp) {
+  this->scrollback = hist_sp;
+}
+inline Glyph Grid::intern(const char *text, size_t length) {
+  return graphemes.intern(text, length);
+}
+inline void Grid::discard(Glyph glyph) { graphemes.discard(glyph); }
+inline void Grid::assign(TermCell &to, const TermCell &from) {
+  graphemes.retain(from.glyph);
+  graphemes.release(to.glyph);
+  styles.retain(from.style);
+  styles.release(to.style);
+  to = from;
+}
+inline std::vector<uint32_t> &Grid::screen() {
+  return isNormalScreen ? normalScreen : alternativeScreen;
+}
+inline const std::vector<uint32_t> &Grid::screen() const {
+  return isNormalScreen ? normalScreen : alternativeScreen;
+}
+inline TermCell *Grid::row_cells(int row) {
+  return row_pool[screen()[row]].data();
+}
+
+} // namespace gfx
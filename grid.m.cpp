@@ -0,0 +1,337 @@
+#include "grid.hpp"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace testing;
+
+namespace {
+
+const uint32_t wide_cp = 0x4E2D; // a CJK ideograph, two cells
+
+void write(gfx::Grid &grid, int row, int col, std::string text,
+           uint32_t style = 0) {
+  grid.put_text(row, col, text.data(), text.size(), style);
+}
+
+void write_wide(gfx::Grid &grid, int row, int col) {
+  grid.set_cell(row, col, gfx::TermCell{gfx::Glyph::code_point(wide_cp), 0});
+  grid.set_cell(row, col + 1, gfx::TermCell{gfx::Glyph::empty(), 0});
+}
+
+// The next frame of the grid.
+gfx::Snapshot frame(gfx::Grid &grid) {
+  gfx::Snapshot snapshot;
+  grid.snapshot(snapshot);
+  return snapshot;
+}
+
+// Each row as a string, ASCII as itself, a wide glyph as "#.".
+std::vector<std::string> rows(gfx::Grid &grid) {
+  gfx::Snapshot snapshot = frame(grid);
+
+  std::vector<std::string> out(snapshot.rows);
+  for (int i = 0; i < snapshot.rows * snapshot.cols; i++) {
+    gfx::Glyph glyph = snapshot.cells[i].glyph;
+    char c = glyph.is_empty()               ? '.'
+             : glyph.code_point() < 0x80    ? char(glyph.code_point())
+                                            : '#';
+    out[i / snapshot.cols] += c;
+  }
+  return out;
+}
+
+// A style told apart by its foreground.
+gfx::Style style(uint32_t fg) {
+  gfx::Style s;
+  s.fg_col = fg;
+  return s;
+}
+
+// Whether nothing refers to the style id any more. Its slot is then the next
+// one reused, by the pen set here.
+bool freed(gfx::Grid &grid, uint32_t id) {
+  static uint32_t probe = 0x100;
+  uint32_t next = grid.set_pen(style(probe++));
+  return gfx::StyleTable::index(next) == gfx::StyleTable::index(id);
+}
+
+} // namespace
+
+TEST(Grid, Reflow) {
+  gfx::Grid grid{3, 6};
+
+  // "abcdefgh" wrapped after 6 columns, then a prompt.
+  write(grid, 0, 0, "abcdef");
+  grid.set_wrapped(0, true);
+  write(grid, 1, 0, "gh");
+  write(grid, 2, 0, "$");
+  grid.move_cursor(2, 1);
+
+  grid.resize(3, 4);
+  EXPECT_THAT(rows(grid), ElementsAre("abcd", "efgh", "$   "));
+  EXPECT_EQ(std::make_pair(2, 1), grid.cursor());
+
+  grid.resize(2, 4);
+  EXPECT_THAT(rows(grid), ElementsAre("efgh", "$   "));
+  EXPECT_EQ(std::make_pair(1, 1), grid.cursor());
+
+  // The line scrolled into history comes back.
+  grid.resize(3, 10);
+  EXPECT_THAT(rows(grid), ElementsAre("abcdefgh  ", "$         ", "          "));
+  EXPECT_EQ(std::make_pair(1, 1), grid.cursor());
+}
+
+TEST(Grid, ReflowKeepsWideGlyphsWhole) {
+  gfx::Grid grid{2, 5};
+
+  write(grid, 0, 0, "abc");
+  write_wide(grid, 0, 3);
+  grid.set_wrapped(0, true);
+  write(grid, 1, 0, "d");
+  grid.move_cursor(1, 1);
+
+  // The glyph doesn't fit after "abc", so moves down whole.
+  grid.resize(2, 4);
+  EXPECT_THAT(rows(grid), ElementsAre("abc ", "#.d "));
+  EXPECT_EQ(std::make_pair(1, 3), grid.cursor());
+}
+
+TEST(Grid, InsertDeleteCells) {
+  gfx::Grid grid{2, 6};
+  write(grid, 0, 0, "abcdef");
+  frame(grid);
+
+  // Cells pushed off the end are lost, the damage runs to the end.
+  grid.insert_cells(0, 1, 2);
+  gfx::Snapshot snapshot = frame(grid);
+  EXPECT_EQ(snapshot.generation, snapshot.damage[0].frame);
+  EXPECT_EQ(1, snapshot.damage[0].begin_col);
+  EXPECT_EQ(6, snapshot.damage[0].end_col);
+  EXPECT_NE(snapshot.generation, snapshot.damage[1].frame);
+  EXPECT_THAT(rows(grid), ElementsAre("a  bcd", "      "));
+
+  grid.delete_cells(0, 0, 3);
+  EXPECT_THAT(rows(grid), ElementsAre("bcd   ", "      "));
+
+  gfx::TermCell x{gfx::Glyph::code_point('x'), 0};
+  grid.insert_cells(0, 0, 6, x);
+  EXPECT_THAT(rows(grid), ElementsAre("xxxxxx", "      "));
+}
+
+TEST(Grid, InsertDeleteMoreCellsThanFit) {
+  gfx::Grid grid{1, 6};
+  write(grid, 0, 0, "abcdef");
+
+  // A count past the end of the row clears the rest of it.
+  gfx::TermCell x{gfx::Glyph::code_point('x'), 0};
+  grid.insert_cells(0, 2, 1000, x);
+  EXPECT_THAT(rows(grid), ElementsAre("abxxxx"));
+
+  grid.delete_cells(0, 4, 1000);
+  EXPECT_THAT(rows(grid), ElementsAre("abxx  "));
+
+  // Nothing to do for no cells at all.
+  grid.insert_cells(0, 0, 0, x);
+  grid.delete_cells(0, 0, -1);
+  EXPECT_THAT(rows(grid), ElementsAre("abxx  "));
+}
+
+TEST(Grid, ClearRows) {
+  gfx::Grid grid{3, 4};
+  write(grid, 0, 0, "abcd");
+  grid.set_wrapped(0, true);
+  write(grid, 1, 0, "efgh");
+  write(grid, 2, 0, "ij");
+
+  // Cleared rows no longer continue a line.
+  grid.clear_rows(0, 1);
+  grid.move_cursor(2, 2);
+  grid.resize(3, 8);
+  EXPECT_THAT(rows(grid), ElementsAre("        ", "efgh    ", "ij      "));
+}
+
+TEST(Grid, ScrollRegion) {
+  gfx::Grid grid{5, 3};
+  for (int row = 0; row < 5; row++)
+    write(grid, row, 0, std::string(1, char('a' + row)));
+  grid.move_cursor(4, 0);
+  frame(grid);
+
+  // Only the rows of the region move, and only they are damaged.
+  grid.scroll(1, 4, gfx::Direction::UP, 1);
+  gfx::Snapshot snapshot = frame(grid);
+  EXPECT_NE(snapshot.generation, snapshot.damage[0].frame);
+  for (int row = 1; row < 4; row++)
+    EXPECT_EQ(snapshot.generation, snapshot.damage[row].frame);
+  EXPECT_NE(snapshot.generation, snapshot.damage[4].frame);
+  EXPECT_THAT(rows(grid), ElementsAre("a  ", "c  ", "d  ", "   ", "e  "));
+
+  grid.scroll(1, 4, gfx::Direction::DOWN, 2);
+  EXPECT_THAT(rows(grid), ElementsAre("a  ", "   ", "   ", "c  ", "e  "));
+
+  // Neither went into history, so growing brings nothing back.
+  grid.resize(6, 3);
+  EXPECT_THAT(rows(grid),
+              ElementsAre("a  ", "   ", "   ", "c  ", "e  ", "   "));
+}
+
+TEST(Grid, ScrollIntoHistory) {
+  gfx::Grid grid{3, 4};
+  write(grid, 0, 0, "a");
+  write(grid, 1, 0, "b");
+  write(grid, 2, 0, "c");
+  grid.move_cursor(2, 0);
+
+  // Scrolling down from the top, or on the alternative screen, keeps nothing.
+  grid.scroll(0, 3, gfx::Direction::DOWN, 1);
+  grid.screen_mode_normal(false);
+  write(grid, 0, 0, "alt");
+  grid.scroll(0, 3, gfx::Direction::UP, 1);
+  grid.screen_mode_normal(true);
+  EXPECT_THAT(rows(grid), ElementsAre("    ", "a   ", "b   "));
+
+  write(grid, 2, 0, "c");
+  EXPECT_THAT(rows(grid), ElementsAre("    ", "a   ", "c   "));
+  grid.scroll(0, 3, gfx::Direction::UP, 2);
+  EXPECT_THAT(rows(grid), ElementsAre("c   ", "    ", "    "));
+
+  // The rows scrolled off the top come back, the blank one too.
+  grid.move_cursor(0, 1);
+  grid.resize(4, 4);
+  EXPECT_THAT(rows(grid), ElementsAre("    ", "a   ", "c   ", "    "));
+}
+
+TEST(Grid, ScrollReleasesStyles) {
+  gfx::Grid grid{3, 4};
+  uint32_t dropped = grid.set_pen(style(1));
+  write(grid, 1, 0, "ab", dropped);
+  uint32_t kept = grid.set_pen(style(2));
+  write(grid, 0, 0, "cd", kept);
+  grid.set_pen(gfx::Style{});
+
+  // A row leaving a region lets go of its style, one going into history
+  // holds on to it.
+  grid.scroll(1, 3, gfx::Direction::UP, 1);
+  EXPECT_TRUE(freed(grid, dropped));
+  grid.scroll(0, 3, gfx::Direction::UP, 1);
+  EXPECT_FALSE(freed(grid, kept));
+}
+
+TEST(Grid, ScrollByMoreThanTheRegion) {
+  gfx::Grid grid{4, 2};
+  for (int row = 0; row < 4; row++)
+    write(grid, row, 0, std::string(1, char('a' + row)));
+
+  // As CSI 999 S does, the region is cleared.
+  grid.scroll(1, 3, gfx::Direction::DOWN, 999);
+  EXPECT_THAT(rows(grid), ElementsAre("a ", "  ", "  ", "d "));
+  grid.scroll(0, 4, gfx::Direction::UP, 999);
+  EXPECT_THAT(rows(grid), ElementsAre("  ", "  ", "  ", "  "));
+  grid.scroll(0, 4, gfx::Direction::UP, 0);
+  grid.scroll(3, 1, gfx::Direction::UP, 1);
+}
+
+TEST(Grid, ScrollbackFile) {
+  const std::string path = testing::TempDir() + "grid_history.log";
+  std::remove(path.c_str());
+
+  {
+    gfx::Grid grid{3, 4};
+    grid.set_scrollback(std::make_shared<TermHistory>(path));
+    write(grid, 0, 0, "ab");
+    write_wide(grid, 1, 0);
+    write(grid, 1, 2, "x");
+    write(grid, 2, 0, "yz");
+
+    // Only the rows leaving the top of the screen are written, without
+    // their trailing blanks.
+    grid.scroll(1, 3, gfx::Direction::DOWN, 1);
+    grid.scroll(0, 3, gfx::Direction::UP, 3);
+  }
+
+  std::ifstream file{path};
+  std::string text{std::istreambuf_iterator<char>{file}, {}};
+  EXPECT_EQ("Hello.\nab\n\n\u4E2Dx\n", text);
+  std::remove(path.c_str());
+}
+
+TEST(Grid, PutTextOverWideGlyphs) {
+  gfx::Grid grid{1, 6};
+  write_wide(grid, 0, 0);
+  write_wide(grid, 0, 2);
+  write_wide(grid, 0, 4);
+  frame(grid);
+
+  // Starting on the second half blanks the first, and damages it too.
+  EXPECT_EQ(1, grid.put_text(0, 1, "x", 1, 0));
+  gfx::Snapshot snapshot = frame(grid);
+  EXPECT_EQ(0, snapshot.damage[0].begin_col);
+  EXPECT_EQ(2, snapshot.damage[0].end_col);
+  EXPECT_THAT(rows(grid), ElementsAre(" x#.#."));
+
+  // Ending on the first half blanks the second.
+  EXPECT_EQ(1, grid.put_text(0, 2, "y", 1, 0));
+  snapshot = frame(grid);
+  EXPECT_EQ(2, snapshot.damage[0].begin_col);
+  EXPECT_EQ(4, snapshot.damage[0].end_col);
+  EXPECT_THAT(rows(grid), ElementsAre(" xy #."));
+
+  // Ending at the margin, nothing past it to fix.
+  EXPECT_EQ(2, grid.put_text(0, 4, "zzz", 3, 0));
+  snapshot = frame(grid);
+  EXPECT_EQ(4, snapshot.damage[0].begin_col);
+  EXPECT_EQ(6, snapshot.damage[0].end_col);
+  EXPECT_THAT(rows(grid), ElementsAre(" xy zz"));
+}
+
+TEST(Grid, SetCellOverWideGlyphs) {
+  gfx::Grid grid{1, 6};
+  write_wide(grid, 0, 0);
+  write_wide(grid, 0, 2);
+  write_wide(grid, 0, 4);
+  frame(grid);
+
+  // A glyph on the second half blanks the first.
+  grid.set_cell(0, 1, gfx::TermCell{gfx::Glyph::code_point('x'), 0});
+  gfx::Snapshot snapshot = frame(grid);
+  EXPECT_EQ(0, snapshot.damage[0].begin_col);
+  EXPECT_EQ(2, snapshot.damage[0].end_col);
+  EXPECT_THAT(rows(grid), ElementsAre(" x#.#."));
+
+  // A glyph on the first half blanks the second.
+  grid.set_cell(0, 2, gfx::TermCell{gfx::Glyph::code_point('y'), 0});
+  snapshot = frame(grid);
+  EXPECT_EQ(2, snapshot.damage[0].begin_col);
+  EXPECT_EQ(4, snapshot.damage[0].end_col);
+  EXPECT_THAT(rows(grid), ElementsAre(" xy #."));
+
+  // A wide glyph shifted by one over another keeps its own first half.
+  write_wide(grid, 0, 3);
+  EXPECT_THAT(rows(grid), ElementsAre(" xy#. "));
+}
+
+TEST(Grid, PutTextReplacesStyles) {
+  gfx::Grid grid{2, 4};
+  uint32_t old_style = grid.set_pen(style(1));
+  write(grid, 0, 0, "abcd", old_style);
+  write(grid, 1, 0, "ab", old_style);
+  uint32_t new_style = grid.set_pen(style(2));
+
+  // The old style lives as long as one cell has it.
+  write(grid, 0, 0, "efgh", new_style);
+  EXPECT_FALSE(freed(grid, old_style));
+  write(grid, 1, 0, "ef", new_style);
+  EXPECT_TRUE(freed(grid, old_style));
+
+  // Writing a style over itself keeps it.
+  write(grid, 0, 0, "ijkl", new_style);
+  write(grid, 1, 0, "ij", new_style);
+  EXPECT_FALSE(freed(grid, new_style));
+}
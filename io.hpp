@@ -1,8 +1,10 @@
 #pragma once
 
 #include <condition_variable>
+#include <deque>
 #include <functional>
 #include <mutex>
+#include <string>
 #include <string_view>
 #include <thread>
 #include <vector>
@@ -25,6 +27,9 @@ private:
   std::thread t;
 
 #ifdef _WIN32
+  // Writes come from both the render loop and the parser thread.
+  std::mutex write_mutex;
+
   void* pseudo_terminal{nullptr};
   void* child_process{nullptr};
 
@@ -46,6 +51,12 @@ private:
   boost::asio::io_service service;
   boost::asio::posix::stream_descriptor stream;
   boost::asio::io_service::work work;
+
+  // The stream is only used on the io thread. Reads and writes asked for by
+  // the render loop and the parser thread are posted to it, and writes are
+  // queued there, in order, while one is in flight.
+  std::deque<std::string> pending_writes;
+  void write_next();
 #endif
 
 public:
@@ -55,6 +66,9 @@ public:
   void read_complete();
   // allow next read to happen
 
+  bool input_pending();
+  // whether the child has written more than has been read so far
+
   // perform write to child application
   void write(std::string_view data);
   void write(const char *data, size_t len);
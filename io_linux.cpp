@@ -21,17 +21,19 @@ PseudoTerminal::~PseudoTerminal() {
 }
 
 void PseudoTerminal::read_complete() {
-  stream.async_read_some(
-      boost::asio::buffer(read_buffer.data(), read_buffer.size()),
-      [this](const boost::system::error_code &err, long unsigned int length) {
-        if (err) {
-          std::cerr << "Error message: " << err.message() << "\n";
-          this->_data_cb(this, nullptr, 0u);
-          return;
-        }
-
-        this->_data_cb(this, read_buffer.data(), length);
-      });
+  boost::asio::post(service, [this] {
+    stream.async_read_some(
+        boost::asio::buffer(read_buffer.data(), read_buffer.size()),
+        [this](const boost::system::error_code &err, long unsigned int length) {
+          if (err) {
+            std::cerr << "Error message: " << err.message() << "\n";
+            this->_data_cb(this, nullptr, 0u);
+            return;
+          }
+
+          this->_data_cb(this, read_buffer.data(), length);
+        });
+  });
 }
 
 void PseudoTerminal::write(char data) { write(&data, 1u); }
@@ -54,7 +56,27 @@ void PseudoTerminal::write(const char *data, size_t len) {
   std::cout << '\n';
 #endif
 
-  boost::asio::write(stream, boost::asio::buffer(data, len));
+  boost::asio::post(service, [this, bytes = std::string{data, len}]() mutable {
+    pending_writes.push_back(std::move(bytes));
+    if (pending_writes.size() == 1) {
+      write_next();
+    }
+  });
+}
+
+void PseudoTerminal::write_next() {
+  boost::asio::async_write(
+      stream, boost::asio::buffer(pending_writes.front()),
+      [this](const boost::system::error_code &err, size_t) {
+        if (err) {
+          std::cerr << "Error writing to child: " << err.message() << "\n";
+        }
+
+        pending_writes.pop_front();
+        if (!pending_writes.empty()) {
+          write_next();
+        }
+      });
 }
 
 bool PseudoTerminal::start() {
@@ -100,6 +122,11 @@ bool PseudoTerminal::set_size(int rows, int cols) {
   return true;
 }
 
+bool PseudoTerminal::input_pending() {
+  int available = 0;
+  return -1 != ioctl(parentfd, FIONREAD, &available) && available > 0;
+}
+
 bool PseudoTerminal::fork_child() {
   pid_t p = fork();
   if (p == 0) {
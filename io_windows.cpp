@@ -48,6 +48,13 @@ void PseudoTerminal::read_complete() {
   read_data_state_cv.notify_one();
 }
 
+bool PseudoTerminal::input_pending() {
+  DWORD available = 0;
+  return PeekNamedPipe(child_process_output, nullptr, 0, nullptr, &available,
+                       nullptr) &&
+         available > 0;
+}
+
 void PseudoTerminal::write(char data) { write(&data, 1u); }
 
 void PseudoTerminal::write(std::string_view data) {
@@ -55,6 +62,7 @@ void PseudoTerminal::write(std::string_view data) {
 }
 
 void PseudoTerminal::write(const char *data, size_t len) {
+  std::lock_guard<std::mutex> lock{write_mutex};
   DWORD bytes_written;
   if (!WriteFile(child_process_input, data, (DWORD) len, &bytes_written, NULL)) {
     throw std::runtime_error("write error");
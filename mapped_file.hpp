@@ -0,0 +1,34 @@
+#pragma once
+#include <stddef.h>
+#include <string>
+
+namespace io {
+
+class MappedFile {
+  // A whole file mapped read only into memory, empty if it couldn't be.
+  const char *d_data = nullptr;
+  size_t d_size = 0;
+
+#ifdef _WIN32
+  void *file = nullptr;
+  void *mapping = nullptr;
+#endif
+
+public:
+  explicit MappedFile(const std::string &path);
+  ~MappedFile();
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  const char *data() const { return d_data; }
+  size_t size() const { return d_size; }
+
+  explicit operator bool() const { return d_data != nullptr; }
+};
+
+std::string cache_directory();
+// Where to keep files which can be rebuilt, created if need be. Empty if
+// there's nowhere.
+
+} // namespace io
@@ -0,0 +1,58 @@
+#include "mapped_file.hpp"
+
+#include <filesystem>
+#include <stdlib.h>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace io {
+
+MappedFile::MappedFile(const std::string &path) {
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) == 0 && st.st_size > 0) {
+    void *addr = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ,
+                      MAP_PRIVATE, fd, 0);
+    if (addr != MAP_FAILED) {
+      d_data = static_cast<const char *>(addr);
+      d_size = static_cast<size_t>(st.st_size);
+    }
+  }
+
+  // The mapping outlives the descriptor.
+  close(fd);
+}
+
+MappedFile::~MappedFile() {
+  if (d_data != nullptr) {
+    munmap(const_cast<char *>(d_data), d_size);
+  }
+}
+
+std::string cache_directory() {
+  std::filesystem::path dir;
+
+  if (const char *xdg = getenv("XDG_CACHE_HOME"); xdg && *xdg) {
+    dir = xdg;
+  } else if (const char *home = getenv("HOME"); home && *home) {
+    dir = std::filesystem::path{home} / ".cache";
+  } else {
+    return {};
+  }
+
+  dir /= "peachterm";
+
+  std::error_code ec;
+  std::filesystem::create_directories(dir, ec);
+  return ec ? std::string{} : dir.string();
+}
+
+} // namespace io
@@ -0,0 +1,64 @@
+#include "mapped_file.hpp"
+
+#include <filesystem>
+#include <stdlib.h>
+#include <system_error>
+
+#include <Windows.h>
+
+namespace io {
+
+MappedFile::MappedFile(const std::string &path) {
+  HANDLE f = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                         OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (f == INVALID_HANDLE_VALUE) {
+    return;
+  }
+  file = f;
+
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(f, &size) || size.QuadPart == 0) {
+    return;
+  }
+
+  HANDLE m = CreateFileMappingA(f, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (m == nullptr) {
+    return;
+  }
+  mapping = m;
+
+  void *view = MapViewOfFile(m, FILE_MAP_READ, 0, 0, 0);
+  if (view != nullptr) {
+    d_data = static_cast<const char *>(view);
+    d_size = static_cast<size_t>(size.QuadPart);
+  }
+}
+
+MappedFile::~MappedFile() {
+  if (d_data != nullptr) {
+    UnmapViewOfFile(d_data);
+  }
+  if (mapping != nullptr) {
+    CloseHandle(mapping);
+  }
+  if (file != nullptr) {
+    CloseHandle(file);
+  }
+}
+
+std::string cache_directory() {
+  char *local = nullptr;
+  size_t length = 0;
+  if (_dupenv_s(&local, &length, "LOCALAPPDATA") != 0 || local == nullptr) {
+    return {};
+  }
+
+  std::filesystem::path dir = std::filesystem::path{local} / "peachterm";
+  free(local);
+
+  std::error_code ec;
+  std::filesystem::create_directories(dir, ec);
+  return ec ? std::string{} : dir.string();
+}
+
+} // namespace io
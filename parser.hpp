@@ -1,49 +1,501 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
 #include <iostream>
 #include <stddef.h>
+#include <stdint.h>
+#include <string>
 #include <string_view>
-#include <vector>
+
+#include "parser_tables.hpp"
+#include "scanner.hpp"
+#include "segmenter.hpp"
+#include "util.hpp"
 
 namespace parser {
 
-enum class STATE { NORMAL, UTF8, ESCAPE, CSI, OSI, CHARSET };
+class CSIParams {
+  // The numeric parameters of a control sequence, accumulated a digit at a
+  // time while it is parsed. Parameters separated by ':' rather than ';' are
+  // sub-parameters of the one before, e.g. the 2, 0, 1, 2, 3 of "38:2::1:2:3".
+  // Missing parameters are 0. Anything past the capacity is dropped.
+public:
+  static constexpr size_t capacity = 32;
+
+  using value_type = int;
+  using const_iterator = const int *;
+
+private:
+  std::array<int, capacity> values{};
+  uint32_t sub_params = 0; // bit n is set if values[n] followed a ':'
+  size_t count = 0;
+  bool overflowed = false;
+
+public:
+  const_iterator begin() const { return values.data(); }
+  const_iterator end() const { return values.data() + count; }
+  size_t size() const { return count; }
+  bool empty() const { return count == 0; }
+  int operator[](size_t n) const { return values[n]; }
+
+  bool is_sub_param(size_t n) const { return (sub_params >> n) & 1u; }
+  bool overflow() const { return overflowed; }
+
+  void clear();
+  void push_digit(char c);
+  void push_separator(char c);
+};
+
+inline void CSIParams::clear() {
+  count = 0;
+  sub_params = 0;
+  overflowed = false;
+}
 
-class VTParser {
+inline void CSIParams::push_digit(char c) {
+  if (count == 0) {
+    values[count++] = 0;
+  }
+  if (overflowed) {
+    return;
+  }
+  int &value = values[count - 1];
+  // Clamp rather than overflow, no parameter means anything this large.
+  value = value >= 10000 ? value : value * 10 + (c - '0');
+}
+
+inline void CSIParams::push_separator(char c) {
+  if (count == 0) {
+    values[count++] = 0;
+  }
+  if (count == capacity) {
+    overflowed = true;
+    return;
+  }
+  if (c == ':') {
+    sub_params |= 1u << count;
+  }
+  values[count++] = 0;
+}
+
+template <typename Handler> class BasicVTParser {
+  // Parses the output of the child and reports what it finds by calling
+  // the on_* functions of Handler, which derives from this class. The calls
+  // are resolved statically so they can be inlined into the parse loop.
+  // Handler need only define the callbacks it is interested in.
   std::string command;
-  STATE state;
+  CSIParams params;
+  STATE state{STATE::GROUND};
+  Segmenter segmenter;
+
+  // OSC strings are parsed as they arrive, "<number>;<string>". The string
+  // is kept up to max_osc_length, longer ones are dropped. OSC 52 sets the
+  // clipboard, "52;<selection>;<base64>", and is decoded as it streams in
+  // rather than kept. Only a string ended by BEL or ST is dispatched, one
+  // cut short by CAN, SUB or another escape is dropped.
+  enum class OSC_PHASE : uint8_t { NUMBER, STRING, SELECTION, CLIPBOARD, INVALID };
+
+  std::string osc;
+  OSC_PHASE osc_phase{OSC_PHASE::NUMBER};
+  int osc_number{-1};
+  bool osc_overflow{false};
+  util::Base64Decoder base64;
+  std::array<char, 256> clipboard;
+  size_t clipboard_length{0};
 
 public:
-  VTParser();
-  virtual ~VTParser() {}
+  static constexpr size_t max_osc_length = 4096;
+  static constexpr size_t max_selection_length = 16;
 
   void parse_input(const char *input, size_t length);
   void parse_input(char c);
+  void flush_text();
+  // Hand over text held back at the end of the last chunk, for when no more
+  // is coming for now.
 
-  void dispatch_osi(const char *input, size_t length);
-  void dispatch_csi(const char *input, size_t length);
+  void dispatch_csi(char op);
   void dispatch_esc(char op);
 
+private:
+  Handler &handler() { return static_cast<Handler &>(*this); }
+
+  void put_ascii(const char *data, size_t length);
+  void put_cluster(const char *data, size_t length);
+
+  void perform(ACTION action, char c);
+  void execute(char c);
+  void esc_dispatch(char c);
+
+  void osc_start();
+  void osc_put(const char *data, size_t length);
+  void osc_end(char c);
+  // Leaving the string on c, dispatch it if that completes it.
+
 public:
-  virtual void on_glyph(const char *glyph, size_t length) {
+  void on_glyph(const char *glyph, size_t length) {
     (void)glyph;
     (void)length;
   }
-  virtual void on_newline(){}
-  virtual void on_return(){}
-  virtual void on_tab(){}
-  virtual void on_backspace(){}
-  virtual void on_bell(){}
-  virtual void on_charset(char c) { (void)c; }
-  virtual void on_csi(char op, const std::vector<int> &args,
-                      std::string_view options) {
+  void on_text(const char *text, size_t length) {
+    // A run of printable ASCII, each byte is one glyph.
+    for (size_t i = 0; i < length; i++) {
+      handler().on_glyph(text + i, 1u);
+    }
+  }
+  void on_newline() {}
+  void on_return() {}
+  void on_tab() {}
+  void on_backspace() {}
+  void on_bell() {}
+  void on_charset(char c) { (void)c; }
+  void on_csi(char op, const CSIParams &args, std::string_view options) {
     (void)op;
     (void)args;
     (void)options;
   }
-  virtual void on_ri(){}
-  virtual void on_esc(char op){ (void)op; }
+  void on_ri() {}
+  void on_esc(char op) { (void)op; }
+  void on_osi(int op, std::string_view data) {
+    (void)op;
+    (void)data;
+  }
+  void on_clipboard_begin(std::string_view selection) { (void)selection; }
+  void on_clipboard_data(const char *data, size_t length) {
+    (void)data;
+    (void)length;
+  }
+  void on_clipboard_end() {}
+  void on_clipboard_abort() {}
+  // The data so far should be dropped, the string was cut short.
+};
+
+class VTParser : public BasicVTParser<VTParser> {
+  // Dispatches each callback virtually, for handlers which are chosen at
+  // run time or mocked.
+  using Base = BasicVTParser<VTParser>;
+
+public:
+  virtual ~VTParser() {}
+
+  virtual void on_glyph(const char *glyph, size_t length) {
+    Base::on_glyph(glyph, length);
+  }
+  virtual void on_text(const char *text, size_t length) {
+    Base::on_text(text, length);
+  }
+  virtual void on_newline() {}
+  virtual void on_return() {}
+  virtual void on_tab() {}
+  virtual void on_backspace() {}
+  virtual void on_bell() {}
+  virtual void on_charset(char c) { (void)c; }
+  virtual void on_csi(char op, const CSIParams &args,
+                      std::string_view options) {
+    Base::on_csi(op, args, options);
+  }
+  virtual void on_ri() {}
+  virtual void on_esc(char op) { (void)op; }
   virtual void on_osi(int, std::string_view) = 0;
+  virtual void on_clipboard_begin(std::string_view selection) {
+    (void)selection;
+  }
+  virtual void on_clipboard_data(const char *data, size_t length) {
+    (void)data;
+    (void)length;
+  }
+  virtual void on_clipboard_end() {}
+  virtual void on_clipboard_abort() {}
 };
 
+extern template class BasicVTParser<VTParser>;
+
+template <typename Handler>
+void BasicVTParser<Handler>::parse_input(const char *input, size_t length) {
+  segmenter.feed(
+      input, length,
+      [this](const char *data, size_t len) { put_ascii(data, len); },
+      [this](const char *data, size_t len) { put_cluster(data, len); });
+
+  // Only text on screen can be extended by the next chunk, so don't keep the
+  // end of an escape sequence waiting.
+  if (state != STATE::GROUND) {
+    flush_text();
+  }
+}
+
+template <typename Handler>
+void BasicVTParser<Handler>::flush_text() {
+  segmenter.flush(
+      [this](const char *data, size_t len) { put_ascii(data, len); },
+      [this](const char *data, size_t len) { put_cluster(data, len); });
+}
+
+template <typename Handler>
+void BasicVTParser<Handler>::put_ascii(const char *data, size_t length) {
+  const char *end = data + length;
+
+  while (data != end) {
+    if (state == STATE::GROUND || state == STATE::OSC_STRING) {
+      // Hand whole runs of printable characters over at once.
+      const char *run_end = find_non_printable(data, end);
+      size_t run_length = static_cast<size_t>(run_end - data);
+
+      if (run_length != 0) {
+        if (state == STATE::GROUND) {
+          handler().on_text(data, run_length);
+        } else {
+          osc_put(data, run_length);
+        }
+        data = run_end;
+        continue;
+      }
+    }
+
+    parse_input(*data++);
+  }
+}
+
+template <typename Handler>
+void BasicVTParser<Handler>::put_cluster(const char *data, size_t length) {
+  if (state == STATE::OSC_STRING) {
+    osc_put(data, length);
+    return;
+  }
+
+  if (state != STATE::GROUND) {
+    // Part of a sequence, e.g. a window title containing UTF-8.
+    for (size_t i = 0; i < length; i++) {
+      parse_input(data[i]);
+    }
+    return;
+  }
+
+  handler().on_glyph(data, length);
+}
+
+template <typename Handler>
+void BasicVTParser<Handler>::parse_input(char c) {
+  const auto &row = detail::transitions[static_cast<size_t>(state)];
+  const detail::Transition t = row[static_cast<unsigned char>(c)];
+
+  if (!detail::changes_state(t)) {
+    perform(detail::action_of(t), c);
+    return;
+  }
+
+  perform(detail::exit_actions[static_cast<size_t>(state)], c);
+  perform(detail::action_of(t), c);
+  state = detail::state_of(t);
+  perform(detail::entry_actions[static_cast<size_t>(state)], c);
+}
+
+template <typename Handler>
+void BasicVTParser<Handler>::perform(ACTION action, char c) {
+  switch (action) {
+  case ACTION::NONE:
+  case ACTION::IGNORE:
+    break;
+  case ACTION::PRINT:
+    handler().on_glyph(&c, 1u);
+    break;
+  case ACTION::EXECUTE:
+    execute(c);
+    break;
+  case ACTION::CLEAR:
+    command.clear();
+    params.clear();
+    break;
+  case ACTION::OSC_START:
+    osc_start();
+    break;
+  case ACTION::COLLECT:
+    command.push_back(c);
+    break;
+  case ACTION::OSC_PUT:
+    osc_put(&c, 1u);
+    break;
+  case ACTION::PARAM:
+    if (c == ';' || c == ':') {
+      params.push_separator(c);
+    } else {
+      params.push_digit(c);
+    }
+    break;
+  case ACTION::ESC_DISPATCH:
+    esc_dispatch(c);
+    break;
+  case ACTION::CSI_DISPATCH:
+    dispatch_csi(c);
+    break;
+  case ACTION::OSC_END:
+    osc_end(c);
+    break;
+  case ACTION::HOOK:
+  case ACTION::PUT:
+  case ACTION::UNHOOK:
+    // Device control strings are consumed but not acted on.
+    break;
+  }
+}
+
+template <typename Handler>
+void BasicVTParser<Handler>::execute(char c) {
+  // clang-format off
+  switch(c) {
+    case '\n': handler().on_newline();   break;
+    case '\v': handler().on_newline();   break;
+    case '\f': handler().on_newline();   break;
+    case '\r': handler().on_return();    break;
+    case '\t': handler().on_tab();       break;
+    case '\a': handler().on_bell();      break;
+    case '\b': handler().on_backspace(); break;
+    default:   /* ignore */              break;
+  }
+  // clang-format on
+}
+
+template <typename Handler>
+void BasicVTParser<Handler>::esc_dispatch(char c) {
+  // command holds any intermediate bytes.
+  if (command == "(") {
+    handler().on_charset(c);
+  } else if (!command.empty()) {
+    // ignore other character sets, DECALN, etc.
+  } else if (c == 'M') {
+    handler().on_ri();
+  } else if (c == '\\') {
+    // string terminator, outside of a string.
+  } else {
+    dispatch_esc(c);
+  }
+}
+
+template <typename Handler> void BasicVTParser<Handler>::osc_start() {
+  osc.clear();
+  osc_phase = OSC_PHASE::NUMBER;
+  osc_number = -1;
+  osc_overflow = false;
+}
+
+template <typename Handler>
+void BasicVTParser<Handler>::osc_put(const char *data, size_t length) {
+  const char *end = data + length;
+
+  while (data != end) {
+    switch (osc_phase) {
+    case OSC_PHASE::NUMBER: {
+      char c = *data++;
+      if (c >= '0' && c <= '9') {
+        osc_number = std::min(std::max(osc_number, 0) * 10 + (c - '0'), 99999);
+      } else if (c == ';' && osc_number >= 0) {
+        osc_phase = osc_number == 52 ? OSC_PHASE::SELECTION : OSC_PHASE::STRING;
+      } else {
+        osc_phase = OSC_PHASE::INVALID;
+      }
+    } break;
+    case OSC_PHASE::STRING: {
+      size_t room = max_osc_length - osc.size();
+      size_t n = std::min(room, static_cast<size_t>(end - data));
+      osc.append(data, n);
+      data += n;
+      if (data != end) {
+        osc_overflow = true;
+        data = end;
+      }
+    } break;
+    case OSC_PHASE::SELECTION: {
+      char c = *data++;
+      if (c == ';') {
+        handler().on_clipboard_begin(osc);
+        osc_phase = OSC_PHASE::CLIPBOARD;
+        base64.reset();
+        clipboard_length = 0;
+      } else if (osc.size() < max_selection_length) {
+        osc.push_back(c);
+      } else {
+        osc_phase = OSC_PHASE::INVALID;
+      }
+    } break;
+    case OSC_PHASE::CLIPBOARD:
+      for (; data != end; ++data) {
+        clipboard_length +=
+            base64.decode(*data, clipboard.data() + clipboard_length);
+        if (clipboard_length == clipboard.size()) {
+          handler().on_clipboard_data(clipboard.data(), clipboard_length);
+          clipboard_length = 0;
+        }
+      }
+      break;
+    case OSC_PHASE::INVALID:
+      data = end;
+      break;
+    }
+  }
+}
+
+template <typename Handler>
+void BasicVTParser<Handler>::osc_end(char c) {
+  if (state == STATE::OSC_STRING && c == '\33') {
+    // Maybe the start of ST, see OSC_ESCAPE.
+    return;
+  }
+
+  const bool complete = (state == STATE::OSC_STRING && c == '\a') ||
+                        (state == STATE::OSC_ESCAPE && c == '\\');
+
+  switch (osc_phase) {
+  case OSC_PHASE::STRING:
+    if (complete && !osc_overflow) {
+      handler().on_osi(osc_number, osc);
+    }
+    break;
+  case OSC_PHASE::CLIPBOARD:
+    if (!complete) {
+      handler().on_clipboard_abort();
+      break;
+    }
+    if (clipboard_length != 0) {
+      handler().on_clipboard_data(clipboard.data(), clipboard_length);
+      clipboard_length = 0;
+    }
+    handler().on_clipboard_end();
+    break;
+  default:
+    // malformed, or without a string.
+    break;
+  }
+}
+
+template <typename Handler>
+void BasicVTParser<Handler>::dispatch_csi(char operation) {
+  // command holds the private marker and any intermediate bytes.
+  std::string_view options = command;
+
+#ifdef PEACHTERM_IS_VERBOSE
+  std::cout << "CSI (" << operation << ") ";
+
+  std::cout << "(";
+  for (size_t i = 0; i < params.size(); i++) {
+    std::cout << (params.is_sub_param(i) ? ":" : "") << params[i] << ' ';
+  }
+  std::cout << (params.overflow() ? "..." : "") << ") ";
+
+  std::cout << "[";
+  std::cout << options;
+  std::cout << "]\n";
+#endif
+
+  handler().on_csi(operation, params, options);
+}
+
+template <typename Handler>
+void BasicVTParser<Handler>::dispatch_esc(char op) {
+#ifdef PEACHTERM_IS_VERBOSE
+  std::cout << "ESC: \"" << op << "\"\n";
+#endif
+
+  handler().on_esc(op);
+}
+
 } // namespace parser
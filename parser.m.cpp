@@ -1,4 +1,5 @@
 #include "parser.hpp"
+#include "scanner.hpp"
 
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
@@ -15,6 +16,24 @@ public:
   MOCK_METHOD2(on_osi, void(int, std::string_view));
 };
 
+class MockTextVTParser : public MockVTParser {
+public:
+  MOCK_METHOD2(on_text, void(const char *, size_t));
+};
+
+class MockSeqVTParser : public parser::VTParser {
+public:
+  MOCK_METHOD2(on_glyph, void(const char *, size_t));
+  MOCK_METHOD1(on_charset, void(char));
+  MOCK_METHOD3(on_csi,
+               void(char, const parser::CSIParams &, std::string_view));
+  MOCK_METHOD2(on_osi, void(int, std::string_view));
+  MOCK_METHOD1(on_clipboard_begin, void(std::string_view));
+  MOCK_METHOD2(on_clipboard_data, void(const char *, size_t));
+  MOCK_METHOD0(on_clipboard_end, void(void));
+  MOCK_METHOD0(on_clipboard_abort, void(void));
+};
+
 TEST(VTParser, Simple) {
   MockVTParser p;
 
@@ -32,6 +51,7 @@ TEST(VTParser, ControlSeq) {
 
   char input[] = "\33[38;5;121msize_t\33[m length);";
   p.parse_input(input, sizeof(input) - 1);
+  p.flush_text();
 }
 
 TEST(VTParser, UTF8) {
@@ -41,6 +61,7 @@ TEST(VTParser, UTF8) {
 
   char input[] = "\xc3\xb7";
   p.parse_input(input, sizeof(input) - 1);
+  p.flush_text();
 }
 
 TEST(VTParser, Emoji) {
@@ -50,6 +71,96 @@ TEST(VTParser, Emoji) {
 
   char input[] = "\xF0\x9F\x98\x82";
   p.parse_input(input, sizeof(input) - 1);
+  p.flush_text();
+}
+
+TEST(VTParser, CombiningMark) {
+  MockVTParser p;
+
+  EXPECT_CALL(p, on_glyph(_, 1u)).Times(2).WillRepeatedly(Return());
+  EXPECT_CALL(p, on_glyph(StartsWith("e\xcc\x81"), 3u));
+
+  char input[] = "ae\xcc\x81z";
+  p.parse_input(input, sizeof(input) - 1);
+  p.flush_text();
+}
+
+TEST(VTParser, UTF8SplitAcrossChunks) {
+  MockVTParser p;
+
+  EXPECT_CALL(p, on_glyph(StartsWith("\xF0\x9F\x98\x82"), 4u));
+
+  char input[] = "\xF0\x9F\x98\x82";
+  p.parse_input(input, 1);
+  p.parse_input(input + 1, 2);
+  p.parse_input(input + 3, 1);
+  p.flush_text();
+}
+
+TEST(VTParser, ZWJSequenceSplitAcrossChunks) {
+  MockVTParser p;
+
+  // woman, zwj, laptop
+  EXPECT_CALL(p, on_glyph(_, 11u));
+
+  char input[] = "\xF0\x9F\x91\xA9\xE2\x80\x8D\xF0\x9F\x92\xBB";
+  p.parse_input(input, 7);
+  p.parse_input(input + 7, 4);
+  p.flush_text();
+}
+
+TEST(VTParser, CombiningMarkSplitAcrossChunks) {
+  MockVTParser p;
+
+  EXPECT_CALL(p, on_glyph(StartsWith("e\xcc\x81"), 3u));
+
+  char input[] = "e\xcc\x81";
+  p.parse_input(input, 1);
+  p.parse_input(input + 1, 2);
+  p.flush_text();
+}
+
+TEST(VTParser, HangulJamo) {
+  MockVTParser p;
+
+  // choseong, jungseong, jongseong form one syllable.
+  EXPECT_CALL(p, on_glyph(_, 9u));
+
+  char input[] = "\xE1\x84\x80\xE1\x85\xA1\xE1\x86\xA8";
+  p.parse_input(input, sizeof(input) - 1);
+  p.flush_text();
+}
+
+TEST(VTParser, RegionalIndicatorPairs) {
+  MockVTParser p;
+
+  // Three flags, the last split across chunks.
+  EXPECT_CALL(p, on_glyph(_, 8u)).Times(3);
+
+  char input[] = "\xF0\x9F\x87\xAC\xF0\x9F\x87\xA7\xF0\x9F\x87\xAB"
+                 "\xF0\x9F\x87\xB7\xF0\x9F\x87\xAF\xF0\x9F\x87\xB5";
+  p.parse_input(input, 20);
+  p.parse_input(input + 20, 4);
+  p.flush_text();
+}
+
+TEST(VTParser, InvalidUTF8Replaced) {
+  MockVTParser p;
+
+  {
+    InSequence seq;
+    EXPECT_CALL(p, on_glyph(StartsWith("a"), 1u));
+    EXPECT_CALL(p, on_glyph(StartsWith("\xEF\xBF\xBD"), 3u));
+    EXPECT_CALL(p, on_glyph(StartsWith("\xC3\xB7"), 2u));
+    EXPECT_CALL(p, on_glyph(StartsWith("\xEF\xBF\xBD"), 3u));
+    EXPECT_CALL(p, on_glyph(StartsWith("b"), 1u));
+  }
+
+  // A stray byte, then a sequence cut short in the next chunk.
+  char input[] = "a\xFF\xC3\xB7\xE2\x82" "b";
+  p.parse_input(input, 5);
+  p.parse_input(input + 5, 2);
+  p.flush_text();
 }
 
 TEST(VTParser, BashPrompt) {
@@ -109,3 +220,227 @@ TEST(VTParser, MinimalMan) {
 
   p.parse_input((char*)input, sizeof(input) - 1);
 }
+
+TEST(VTParser, TextRuns) {
+  MockTextVTParser p;
+
+  InSequence s;
+  EXPECT_CALL(p, on_text(StartsWith("this is"), 7u));
+  EXPECT_CALL(p, on_return());
+  EXPECT_CALL(p, on_newline());
+  EXPECT_CALL(p, on_text(StartsWith("some "), 5u));
+  EXPECT_CALL(p, on_text(StartsWith("text"), 4u));
+  EXPECT_CALL(p, on_text(StartsWith("!"), 1u));
+
+  char input[] = "this is\r\nsome \33[1mtext\33[m!";
+  p.parse_input(input, sizeof(input) - 1);
+  p.flush_text();
+}
+
+TEST(Scanner, MatchesScalar) {
+  std::string buffer(100, 'a');
+
+  for (size_t special = 0; special < buffer.size(); special++) {
+    for (char c : {'\0', '\33', '\n', '\x7f', '\x80', '\xff'}) {
+      std::string s = buffer;
+      s[special] = c;
+
+      const char *begin = s.data();
+      const char *end = s.data() + s.size();
+
+      ASSERT_EQ(begin + special, parser::find_non_printable(begin, end));
+      ASSERT_EQ(static_cast<unsigned char>(c) >= 0x80 ? begin + special : end,
+                parser::find_non_ascii(begin, end));
+
+      // Starting after the special byte finds nothing.
+      ASSERT_EQ(end, parser::find_non_printable(begin + special + 1, end));
+    }
+  }
+}
+
+TEST(VTParser, OSCTerminators) {
+  MockSeqVTParser p;
+
+  InSequence s;
+  EXPECT_CALL(p, on_osi(0, std::string_view{"bel title"}));
+  EXPECT_CALL(p, on_osi(2, std::string_view{"st title"}));
+
+  char input[] = "\033]0;bel title\a\033]2;st title\033\\";
+  p.parse_input(input, sizeof(input) - 1);
+}
+
+TEST(VTParser, OSCAborted) {
+  MockSeqVTParser p;
+
+  // Cancelled, or cut short by another escape sequence, then complete.
+  InSequence s;
+  EXPECT_CALL(p, on_glyph(_, 1u));
+  EXPECT_CALL(p, on_csi('m', _, _));
+  EXPECT_CALL(p, on_osi(0, std::string_view{"done"}));
+
+  char input[] = "\033]0;cancelled\030x\033]0;cut\033[m\033]0;done\033\\";
+  p.parse_input(input, sizeof(input) - 1);
+}
+
+TEST(VTParser, OSCClipboardAborted) {
+  MockSeqVTParser p;
+
+  InSequence s;
+  EXPECT_CALL(p, on_clipboard_begin(std::string_view{"c"}));
+  EXPECT_CALL(p, on_clipboard_data(_, _)).Times(AnyNumber());
+  EXPECT_CALL(p, on_clipboard_abort());
+  EXPECT_CALL(p, on_clipboard_end()).Times(0);
+
+  char input[] = "\033]52;c;aGVs\032";
+  p.parse_input(input, sizeof(input) - 1);
+}
+
+TEST(VTParser, CSIFinalTilde) {
+  MockSeqVTParser p;
+
+  EXPECT_CALL(p, on_csi('~', ElementsAre(3), std::string_view{}));
+  EXPECT_CALL(p, on_glyph(_, _)).Times(0);
+
+  char input[] = "\033[3~";
+  p.parse_input(input, sizeof(input) - 1);
+}
+
+TEST(VTParser, CSIPrivateMarker) {
+  MockSeqVTParser p;
+
+  EXPECT_CALL(p, on_csi('h', ElementsAre(1049), std::string_view{"?"}));
+
+  char input[] = "\033[?1049h";
+  p.parse_input(input, sizeof(input) - 1);
+}
+
+TEST(VTParser, EscapeIntermediates) {
+  MockSeqVTParser p;
+
+  EXPECT_CALL(p, on_charset('B'));
+  // DECALN is not printed.
+  EXPECT_CALL(p, on_glyph(_, _)).Times(0);
+
+  char input[] = "\033(B\033#8";
+  p.parse_input(input, sizeof(input) - 1);
+}
+
+TEST(VTParser, DCSIsConsumed) {
+  MockSeqVTParser p;
+
+  EXPECT_CALL(p, on_glyph(_, 1u)).Times(2).WillRepeatedly(Return());
+
+  char input[] = "\033P1$r0m\033\\ok";
+  p.parse_input(input, sizeof(input) - 1);
+  p.flush_text();
+}
+
+TEST(VTParser, CancelAbortsSequence) {
+  MockSeqVTParser p;
+
+  EXPECT_CALL(p, on_csi(_, _, _)).Times(0);
+  EXPECT_CALL(p, on_glyph(_, 1u)).Times(1);
+
+  char input[] = "\033[31\030x";
+  p.parse_input(input, sizeof(input) - 1);
+  p.flush_text();
+}
+
+TEST(VTParser, CSIEmptyParams) {
+  MockSeqVTParser p;
+
+  InSequence s;
+  EXPECT_CALL(p, on_csi('H', ElementsAre(0, 5), _));
+  EXPECT_CALL(p, on_csi('m', IsEmpty(), _));
+
+  char input[] = "\033[;5H\033[m";
+  p.parse_input(input, sizeof(input) - 1);
+}
+
+TEST(VTParser, CSISubParams) {
+  MockSeqVTParser p;
+
+  parser::CSIParams args;
+  EXPECT_CALL(p, on_csi('m', ElementsAre(38, 2, 0, 10, 20, 30, 1), _))
+      .WillOnce(SaveArg<1>(&args));
+
+  char input[] = "\033[38:2::10:20:30;1m";
+  p.parse_input(input, sizeof(input) - 1);
+
+  EXPECT_FALSE(args.is_sub_param(0));
+  for (size_t i = 1; i <= 5; i++) {
+    EXPECT_TRUE(args.is_sub_param(i));
+  }
+  EXPECT_FALSE(args.is_sub_param(6));
+  EXPECT_FALSE(args.overflow());
+}
+
+TEST(VTParser, CSIParamOverflow) {
+  MockSeqVTParser p;
+
+  parser::CSIParams args;
+  EXPECT_CALL(p, on_csi('m', SizeIs(parser::CSIParams::capacity), _))
+      .WillOnce(SaveArg<1>(&args));
+
+  std::string input = "\033[";
+  for (int i = 0; i < 40; i++) {
+    input += std::to_string(i) + ";";
+  }
+  input += "99999999m";
+  p.parse_input(input.data(), input.size());
+
+  EXPECT_TRUE(args.overflow());
+  EXPECT_EQ(31, args[31]);
+}
+
+TEST(VTParser, OSCMalformedNumber) {
+  MockSeqVTParser p;
+
+  EXPECT_CALL(p, on_osi(_, _)).Times(0);
+  EXPECT_CALL(p, on_glyph(_, 1u)).Times(1);
+
+  char input[] = "\033]abc;title\a\033];title\a\033]1x2;title\ax";
+  p.parse_input(input, sizeof(input) - 1);
+  p.flush_text();
+}
+
+TEST(VTParser, OSCTooLong) {
+  MockSeqVTParser p;
+
+  InSequence s;
+  EXPECT_CALL(p, on_osi(_, _)).Times(0);
+  EXPECT_CALL(p, on_osi(2, std::string_view{"ok"}));
+
+  std::string input = "\033]2;";
+  input.append(parser::VTParser::max_osc_length + 1, 'x');
+  input += "\a\033]2;ok\a";
+  p.parse_input(input.data(), input.size());
+}
+
+TEST(VTParser, OSCClipboardStreamed) {
+  MockSeqVTParser p;
+
+  std::string decoded;
+  auto append = [&decoded](const char *data, size_t length) {
+    decoded.append(data, length);
+  };
+
+  InSequence s;
+  EXPECT_CALL(p, on_clipboard_begin(std::string_view{"c"}));
+  EXPECT_CALL(p, on_clipboard_data(_, _)).WillRepeatedly(Invoke(append));
+  EXPECT_CALL(p, on_clipboard_end());
+
+  // 3000 bytes of payload, split over several chunks.
+  std::string payload;
+  for (int i = 0; i < 1000; i++) {
+    payload += "aGVs"; // "hel"
+  }
+  std::string input = "\033]52;c;" + payload + "\033\\";
+
+  for (size_t pos = 0; pos < input.size(); pos += 100) {
+    p.parse_input(input.data() + pos, std::min<size_t>(100, input.size() - pos));
+  }
+
+  ASSERT_EQ(3000u, decoded.size());
+  ASSERT_EQ("helhel", decoded.substr(0, 6));
+}
@@ -0,0 +1,121 @@
+#include "parser.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// Times the parser over synthetic build output, mixed CJK and emoji text and
+// random binary, fed in pty sized chunks, once with static dispatch to the handler and
+// once through VTParser.
+
+namespace {
+
+class StaticCounter : public parser::BasicVTParser<StaticCounter> {
+public:
+  size_t glyphs = 0;
+  size_t sequences = 0;
+
+  void on_glyph(const char *, size_t) { glyphs++; }
+  void on_text(const char *, size_t length) { glyphs += length; }
+  void on_newline() { sequences++; }
+  void on_csi(char, const parser::CSIParams &, std::string_view) {
+    sequences++;
+  }
+};
+
+class VirtualCounter : public parser::VTParser {
+public:
+  size_t glyphs = 0;
+  size_t sequences = 0;
+
+  void on_glyph(const char *, size_t) override { glyphs++; }
+  void on_text(const char *, size_t length) override { glyphs += length; }
+  void on_newline() override { sequences++; }
+  void on_csi(char, const parser::CSIParams &, std::string_view) override {
+    sequences++;
+  }
+  void on_osi(int, std::string_view) override {}
+};
+
+const std::vector<std::string> build_lines = {
+    "[ 42%] Building CXX object CMakeFiles/jterm.dir/graphics.cpp.o\r\n",
+    "\033[01m\033[Kapp.cpp:123:5:\033[m\033[K \033[01;31m\033[Kerror: "
+    "\033[m\033[K'foo' was not declared in this scope\r\n",
+    "\033[38;2;255;128;0mwarning\033[0m: unused variable \xe2\x80\x98x"
+    "\xe2\x80\x99 \xe2\x9c\x93 \xf0\x9f\x98\x82\r\n",
+    "drwxr-xr-x  2 user user 4096 Jan  1 00:00 \033[01;34mdirectory\033[0m"
+    "\r\n",
+};
+
+const std::vector<std::string> cjk_lines = {
+    // 日本語のテキスト 中文字符 한국어 텍스트
+    "\xe6\x97\xa5\xe6\x9c\xac\xe8\xaa\x9e\xe3\x81\xae\xe3\x83\x86\xe3\x82"
+    "\xad\xe3\x82\xb9\xe3\x83\x88 \xe4\xb8\xad\xe6\x96\x87\xe5\xad\x97\xe7"
+    "\xac\xa6 \xed\x95\x9c\xea\xb5\xad\xec\x96\xb4 \xed\x85\x8d\xec\x8a\xa4"
+    "\xed\x8a\xb8\r\n",
+    // 👩‍💻 🇬🇧 👍🏽 ❤️ café
+    "\033[1m\xf0\x9f\x91\xa9\xe2\x80\x8d\xf0\x9f\x92\xbb\033[0m \xf0\x9f"
+    "\x87\xac\xf0\x9f\x87\xa7 \xf0\x9f\x91\x8d\xf0\x9f\x8f\xbd \xe2\x9d"
+    "\xa4\xef\xb8\x8f cafe\xcc\x81\r\n",
+};
+
+std::string make_input(const std::vector<std::string> &lines, size_t size) {
+  std::string input;
+  for (size_t i = 0; input.size() < size; i++) {
+    input += lines[i % lines.size()];
+  }
+  return input;
+}
+
+std::string make_binary(size_t size) {
+  std::mt19937 random{42};
+  std::string input(size, '\0');
+  for (char &c : input) {
+    c = static_cast<char>(random());
+  }
+  return input;
+}
+
+template <typename Parser>
+void run(const char *name, const std::string &input, int repeats) {
+  constexpr size_t chunk = 1024;
+
+  Parser p;
+
+  auto start = std::chrono::steady_clock::now();
+
+  for (int r = 0; r < repeats; r++) {
+    for (size_t pos = 0; pos < input.size(); pos += chunk) {
+      p.parse_input(input.data() + pos, std::min(chunk, input.size() - pos));
+    }
+  }
+
+  auto end = std::chrono::steady_clock::now();
+  std::chrono::duration<double> seconds = end - start;
+
+  double mb = static_cast<double>(input.size()) * repeats / (1024 * 1024);
+
+  std::cout << name << ": " << mb / seconds.count() << " MB/s ("
+            << p.glyphs << " glyphs, " << p.sequences << " sequences)\n";
+}
+} // namespace
+
+int main(int argc, char *argv[]) {
+  int repeats = argc > 1 ? std::stoi(argv[1]) : 20;
+
+  std::string build = make_input(build_lines, 8 * 1024 * 1024);
+  std::string cjk = make_input(cjk_lines, 8 * 1024 * 1024);
+  std::string binary = make_binary(8 * 1024 * 1024);
+
+  run<VirtualCounter>("build virtual", build, repeats);
+  run<StaticCounter>("build static ", build, repeats);
+  run<VirtualCounter>("cjk virtual  ", cjk, repeats);
+  run<StaticCounter>("cjk static   ", cjk, repeats);
+  run<VirtualCounter>("bin virtual  ", binary, repeats);
+  run<StaticCounter>("bin static   ", binary, repeats);
+
+  return 0;
+}
@@ -0,0 +1,216 @@
+#pragma once
+
+#include <array>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace parser {
+
+// The states of the DEC/ANSI parser described at
+// https://vt100.net/emu/dec_ansi_parser
+enum class STATE : uint8_t {
+  GROUND,
+  ESCAPE,
+  ESCAPE_INTERMEDIATE,
+  CSI_ENTRY,
+  CSI_PARAM,
+  CSI_INTERMEDIATE,
+  CSI_IGNORE,
+  DCS_ENTRY,
+  DCS_PARAM,
+  DCS_INTERMEDIATE,
+  DCS_PASSTHROUGH,
+  DCS_IGNORE,
+  OSC_STRING,
+  OSC_ESCAPE, // ESC in an OSC string, the start of ST or an abort
+  SOS_PM_APC_STRING
+};
+
+enum class ACTION : uint8_t {
+  NONE,
+  IGNORE,
+  PRINT,
+  EXECUTE,
+  CLEAR,
+  COLLECT,
+  PARAM,
+  ESC_DISPATCH,
+  CSI_DISPATCH,
+  HOOK,
+  PUT,
+  UNHOOK,
+  OSC_START,
+  OSC_PUT,
+  OSC_END
+};
+
+namespace detail {
+
+// A transition packs the action to perform into the high nibble, and the
+// state to move to into the low nibble. KEEP stays in the current state
+// without running its exit and entry actions.
+using Transition = uint8_t;
+
+constexpr uint8_t KEEP = 0x0F;
+constexpr size_t num_states = static_cast<size_t>(STATE::SOS_PM_APC_STRING) + 1;
+static_assert(num_states <= KEEP, "states fit below KEEP");
+
+constexpr Transition transition(ACTION action, uint8_t next = KEEP) {
+  return static_cast<uint8_t>(static_cast<uint8_t>(action) << 4 | next);
+}
+
+constexpr Transition transition(ACTION action, STATE next) {
+  return transition(action, static_cast<uint8_t>(next));
+}
+
+constexpr ACTION action_of(Transition t) { return static_cast<ACTION>(t >> 4); }
+constexpr bool changes_state(Transition t) { return (t & 0x0F) != KEEP; }
+constexpr STATE state_of(Transition t) { return static_cast<STATE>(t & 0x0F); }
+
+using TransitionTable = std::array<std::array<Transition, 256>, num_states>;
+using StateActions = std::array<ACTION, num_states>;
+
+constexpr TransitionTable generate_transitions() {
+  // Non-ASCII bytes are never C1 controls here, the input is UTF-8. They are
+  // printed in the ground state and are part of the string in OSC and DCS.
+  using A = ACTION;
+  using S = STATE;
+
+  TransitionTable table{};
+
+  auto set = [&table](S s, int first, int last, Transition t) {
+    for (int c = first; c <= last; c++) {
+      table[static_cast<size_t>(s)][c] = t;
+    }
+  };
+
+  // C0 controls, other than the ones handled the same in every state.
+  auto set_c0 = [&set](S s, Transition t) {
+    set(s, 0x00, 0x17, t);
+    set(s, 0x19, 0x19, t);
+    set(s, 0x1C, 0x1F, t);
+  };
+
+  for (size_t i = 0; i < num_states; i++) {
+    S s = static_cast<S>(i);
+    set(s, 0x00, 0xFF, transition(A::IGNORE));
+  }
+
+  // clang-format off
+  set_c0(S::GROUND,               transition(A::EXECUTE));
+  set(S::GROUND,     0x20, 0x7E,  transition(A::PRINT));
+  set(S::GROUND,     0x80, 0xFF,  transition(A::PRINT));
+
+  set_c0(S::ESCAPE,               transition(A::EXECUTE));
+  set(S::ESCAPE,     0x20, 0x2F,  transition(A::COLLECT, S::ESCAPE_INTERMEDIATE));
+  set(S::ESCAPE,     0x30, 0x7E,  transition(A::ESC_DISPATCH, S::GROUND));
+  set(S::ESCAPE,     0x50, 0x50,  transition(A::NONE, S::DCS_ENTRY));
+  set(S::ESCAPE,     0x58, 0x58,  transition(A::NONE, S::SOS_PM_APC_STRING));
+  set(S::ESCAPE,     0x5B, 0x5B,  transition(A::NONE, S::CSI_ENTRY));
+  set(S::ESCAPE,     0x5D, 0x5D,  transition(A::NONE, S::OSC_STRING));
+  set(S::ESCAPE,     0x5E, 0x5F,  transition(A::NONE, S::SOS_PM_APC_STRING));
+
+  set_c0(S::ESCAPE_INTERMEDIATE,  transition(A::EXECUTE));
+  set(S::ESCAPE_INTERMEDIATE, 0x20, 0x2F, transition(A::COLLECT));
+  set(S::ESCAPE_INTERMEDIATE, 0x30, 0x7E, transition(A::ESC_DISPATCH, S::GROUND));
+
+  // Colons are sub-parameter separators (as in SGR 38:2::r:g:b), not an
+  // error as the original diagram has them.
+  set_c0(S::CSI_ENTRY,            transition(A::EXECUTE));
+  set(S::CSI_ENTRY,  0x20, 0x2F,  transition(A::COLLECT, S::CSI_INTERMEDIATE));
+  set(S::CSI_ENTRY,  0x30, 0x3B,  transition(A::PARAM, S::CSI_PARAM));
+  set(S::CSI_ENTRY,  0x3C, 0x3F,  transition(A::COLLECT, S::CSI_PARAM));
+  set(S::CSI_ENTRY,  0x40, 0x7E,  transition(A::CSI_DISPATCH, S::GROUND));
+
+  set_c0(S::CSI_PARAM,            transition(A::EXECUTE));
+  set(S::CSI_PARAM,  0x20, 0x2F,  transition(A::COLLECT, S::CSI_INTERMEDIATE));
+  set(S::CSI_PARAM,  0x30, 0x3B,  transition(A::PARAM));
+  set(S::CSI_PARAM,  0x3C, 0x3F,  transition(A::NONE, S::CSI_IGNORE));
+  set(S::CSI_PARAM,  0x40, 0x7E,  transition(A::CSI_DISPATCH, S::GROUND));
+
+  set_c0(S::CSI_INTERMEDIATE,     transition(A::EXECUTE));
+  set(S::CSI_INTERMEDIATE, 0x20, 0x2F, transition(A::COLLECT));
+  set(S::CSI_INTERMEDIATE, 0x30, 0x3F, transition(A::NONE, S::CSI_IGNORE));
+  set(S::CSI_INTERMEDIATE, 0x40, 0x7E, transition(A::CSI_DISPATCH, S::GROUND));
+
+  set_c0(S::CSI_IGNORE,           transition(A::EXECUTE));
+  set(S::CSI_IGNORE, 0x40, 0x7E,  transition(A::NONE, S::GROUND));
+
+  set(S::DCS_ENTRY,  0x20, 0x2F,  transition(A::COLLECT, S::DCS_INTERMEDIATE));
+  set(S::DCS_ENTRY,  0x30, 0x39,  transition(A::PARAM, S::DCS_PARAM));
+  set(S::DCS_ENTRY,  0x3A, 0x3A,  transition(A::NONE, S::DCS_IGNORE));
+  set(S::DCS_ENTRY,  0x3B, 0x3B,  transition(A::PARAM, S::DCS_PARAM));
+  set(S::DCS_ENTRY,  0x3C, 0x3F,  transition(A::COLLECT, S::DCS_PARAM));
+  set(S::DCS_ENTRY,  0x40, 0x7E,  transition(A::NONE, S::DCS_PASSTHROUGH));
+
+  set(S::DCS_PARAM,  0x20, 0x2F,  transition(A::COLLECT, S::DCS_INTERMEDIATE));
+  set(S::DCS_PARAM,  0x30, 0x39,  transition(A::PARAM));
+  set(S::DCS_PARAM,  0x3A, 0x3A,  transition(A::NONE, S::DCS_IGNORE));
+  set(S::DCS_PARAM,  0x3B, 0x3B,  transition(A::PARAM));
+  set(S::DCS_PARAM,  0x3C, 0x3F,  transition(A::NONE, S::DCS_IGNORE));
+  set(S::DCS_PARAM,  0x40, 0x7E,  transition(A::NONE, S::DCS_PASSTHROUGH));
+
+  set(S::DCS_INTERMEDIATE, 0x20, 0x2F, transition(A::COLLECT));
+  set(S::DCS_INTERMEDIATE, 0x30, 0x3F, transition(A::NONE, S::DCS_IGNORE));
+  set(S::DCS_INTERMEDIATE, 0x40, 0x7E, transition(A::NONE, S::DCS_PASSTHROUGH));
+
+  set_c0(S::DCS_PASSTHROUGH,      transition(A::PUT));
+  set(S::DCS_PASSTHROUGH, 0x20, 0x7E, transition(A::PUT));
+  set(S::DCS_PASSTHROUGH, 0x80, 0xFF, transition(A::PUT));
+
+  // BEL is the xterm terminator for OSC strings.
+  set(S::OSC_STRING, 0x07, 0x07,  transition(A::NONE, S::GROUND));
+  set(S::OSC_STRING, 0x20, 0x7F,  transition(A::OSC_PUT));
+  set(S::OSC_STRING, 0x80, 0xFF,  transition(A::OSC_PUT));
+
+  // After an ESC in an OSC string, a backslash completes ST. Anything else
+  // aborts the string and is taken as following a plain ESC.
+  for (int c = 0; c <= 0xFF; c++) {
+    Transition t = table[static_cast<size_t>(S::ESCAPE)][c];
+    set(S::OSC_ESCAPE, c, c, changes_state(t) ? t : transition(action_of(t), S::ESCAPE));
+  }
+  set(S::OSC_ESCAPE, 0x5C, 0x5C,  transition(A::NONE, S::GROUND));
+
+  // Handled the same in every state.
+  for (size_t i = 0; i < num_states; i++) {
+    S s = static_cast<S>(i);
+    set(s, 0x18, 0x18, transition(A::EXECUTE, S::GROUND));
+    set(s, 0x1A, 0x1A, transition(A::EXECUTE, S::GROUND));
+    set(s, 0x1B, 0x1B, transition(A::NONE, S::ESCAPE));
+  }
+  set(S::OSC_STRING, 0x1B, 0x1B,  transition(A::NONE, S::OSC_ESCAPE));
+  // clang-format on
+
+  return table;
+}
+
+constexpr StateActions generate_entry_actions() {
+  StateActions actions{};
+  actions[static_cast<size_t>(STATE::ESCAPE)] = ACTION::CLEAR;
+  actions[static_cast<size_t>(STATE::CSI_ENTRY)] = ACTION::CLEAR;
+  actions[static_cast<size_t>(STATE::DCS_ENTRY)] = ACTION::CLEAR;
+  actions[static_cast<size_t>(STATE::DCS_PASSTHROUGH)] = ACTION::HOOK;
+  actions[static_cast<size_t>(STATE::OSC_ESCAPE)] = ACTION::CLEAR;
+  actions[static_cast<size_t>(STATE::OSC_STRING)] = ACTION::OSC_START;
+  return actions;
+}
+
+constexpr StateActions generate_exit_actions() {
+  StateActions actions{};
+  actions[static_cast<size_t>(STATE::DCS_PASSTHROUGH)] = ACTION::UNHOOK;
+  // Each decides from the byte leaving it whether the string is complete.
+  actions[static_cast<size_t>(STATE::OSC_STRING)] = ACTION::OSC_END;
+  actions[static_cast<size_t>(STATE::OSC_ESCAPE)] = ACTION::OSC_END;
+  return actions;
+}
+
+inline constexpr TransitionTable transitions = generate_transitions();
+inline constexpr StateActions entry_actions = generate_entry_actions();
+inline constexpr StateActions exit_actions = generate_exit_actions();
+
+static_assert(state_of(transitions[0]['\33']) == STATE::ESCAPE);
+static_assert(action_of(transitions[0]['a']) == ACTION::PRINT);
+static_assert(state_of(transitions[static_cast<size_t>(STATE::OSC_ESCAPE)]
+                                  ['[']) == STATE::CSI_ENTRY);
+} // namespace detail
+} // namespace parser
@@ -0,0 +1,136 @@
+#include "rasterizer.hpp"
+#include "text_renderer.h"
+
+#include <SDL.h>
+#include <SDL_ttf.h>
+#include <iostream>
+
+namespace gfx {
+
+namespace {
+
+// Below this many glyphs, waking the workers costs more than it saves.
+constexpr size_t min_parallel_jobs = 8;
+
+TTF_Font *open_font(const std::string &data, int pointsize) {
+  return TTF_OpenFontRW(
+      SDL_RWFromConstMem(data.data(), static_cast<int>(data.size())), 1,
+      pointsize);
+}
+
+} // namespace
+
+Rasterizer::Rasterizer(const FontSpec &spec, int workers) {
+  for (int i = 0; i < workers; i++) {
+    Fonts fonts = {open_font(spec.regular, spec.pointsize),
+                   open_font(spec.italic, spec.pointsize),
+                   open_font(spec.bold, spec.pointsize),
+                   open_font(spec.bolditalic, spec.pointsize)};
+
+    bool opened = true;
+    for (TTF_Font *font : fonts) {
+      opened = opened && font != nullptr;
+    }
+    if (!opened) {
+      std::cerr << "Unable to open fonts for a rasterizer worker\n";
+      for (TTF_Font *font : fonts) {
+        if (font)
+          TTF_CloseFont(font);
+      }
+      break;
+    }
+    worker_fonts.push_back(fonts);
+  }
+
+  for (size_t i = 0; i < worker_fonts.size(); i++) {
+    threads.emplace_back([this, i] { work(i); });
+  }
+}
+
+Rasterizer::~Rasterizer() {
+  {
+    std::lock_guard<std::mutex> lock{mutex};
+    stopping = true;
+  }
+  wake.notify_all();
+
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  for (auto &fonts : worker_fonts) {
+    for (TTF_Font *font : fonts) {
+      TTF_CloseFont(font);
+    }
+  }
+}
+
+void Rasterizer::run(std::vector<Job> &jobs, const Fonts &fonts) {
+  if (threads.empty() || jobs.size() < min_parallel_jobs) {
+    for (auto &job : jobs) {
+      job.surface = rasterize(fonts[job.font], job.text);
+    }
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock{mutex};
+    batch = &jobs;
+    next = 0;
+    busy = threads.size();
+    batch_id++;
+  }
+  wake.notify_all();
+
+  drain(fonts);
+
+  // Every worker takes part in each batch, so none still sees it after this.
+  std::unique_lock<std::mutex> lock{mutex};
+  done.wait(lock, [this] { return busy == 0; });
+  batch = nullptr;
+}
+
+void Rasterizer::work(size_t worker) {
+  uint64_t seen = 0;
+
+  std::unique_lock<std::mutex> lock{mutex};
+  for (;;) {
+    wake.wait(lock, [&] { return stopping || batch_id != seen; });
+    if (stopping) {
+      return;
+    }
+    seen = batch_id;
+
+    lock.unlock();
+    drain(worker_fonts[worker]);
+    lock.lock();
+
+    if (--busy == 0) {
+      done.notify_one();
+    }
+  }
+}
+
+void Rasterizer::drain(const Fonts &fonts) {
+  std::vector<Job> &jobs = *batch;
+
+  for (size_t i = next++; i < jobs.size(); i = next++) {
+    jobs[i].surface = rasterize(fonts[jobs[i].font], jobs[i].text);
+  }
+}
+
+SDL_Surface *Rasterizer::rasterize(TTF_Font *font, const std::string &text) {
+  SDL_Color white;
+  white.r = white.g = white.b = white.a = 255;
+
+  SDL_Surface *surface = TTF_RenderUTF8_Blended(font, text.c_str(), white);
+  if (surface != nullptr && surface->format->format != SDL_PIXELFORMAT_ARGB8888) {
+    SDL_Surface *converted =
+        SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_ARGB8888, 0);
+    SDL_FreeSurface(surface);
+    surface = converted;
+  }
+  return surface;
+}
+
+} // namespace gfx
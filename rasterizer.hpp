@@ -0,0 +1,64 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct SDL_Surface;
+struct _TTF_Font;
+typedef _TTF_Font TTF_Font;
+
+namespace gfx {
+
+class FontSpec;
+
+class Rasterizer {
+  // Rasterizes a frame's glyph misses on a pool of worker threads. FreeType
+  // faces aren't thread safe, so each worker opens its own copy of the fonts,
+  // from the same font data as the renderer's.
+public:
+  using Fonts = std::array<TTF_Font *, 4>; // by bold * 2 + italic
+
+  struct Job {
+    int font = 0; // index into Fonts
+    std::string text;
+    SDL_Surface *surface = nullptr; // ARGB coverage, nullptr if it failed
+  };
+
+  Rasterizer(const FontSpec &spec, int workers);
+  // The spec's font data must outlive the rasterizer.
+  ~Rasterizer();
+
+  Rasterizer(const Rasterizer &) = delete;
+  Rasterizer &operator=(const Rasterizer &) = delete;
+
+  void run(std::vector<Job> &jobs, const Fonts &fonts);
+  // Rasterize every job, the calling thread helping with its own fonts.
+  // Returns once all are done.
+
+  static SDL_Surface *rasterize(TTF_Font *font, const std::string &text);
+  // The glyph as white on transparent, in ARGB8888.
+
+private:
+  void work(size_t worker);
+  void drain(const Fonts &fonts);
+
+  std::vector<Fonts> worker_fonts;
+  std::vector<std::thread> threads;
+
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::condition_variable done;
+  std::vector<Job> *batch = nullptr;
+  uint64_t batch_id = 0;
+  size_t busy = 0;
+  bool stopping = false;
+  std::atomic<size_t> next{0};
+};
+
+} // namespace gfx
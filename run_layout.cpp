@@ -0,0 +1,51 @@
+#include "run_layout.hpp"
+
+#include <limits>
+#include <stddef.h>
+
+namespace gfx {
+
+std::vector<RunPiece> layout_run(const std::vector<ShapedGlyph> &shaped,
+                                 int origin,
+                                 const std::vector<RunCell> &glyphs,
+                                 int cells) {
+  std::vector<RunPiece> pieces;
+
+  // Clusters are in logical order, so one pass over both. A glyph starts a
+  // piece where the shaper drew its cluster; one with no cluster of its own
+  // was joined into the piece before.
+  size_t g = 0;
+  for (size_t i = 0; i < glyphs.size(); i++) {
+    const uint32_t begin = static_cast<uint32_t>(glyphs[i].offset);
+    const uint32_t end = i + 1 < glyphs.size()
+                             ? static_cast<uint32_t>(glyphs[i + 1].offset)
+                             : std::numeric_limits<uint32_t>::max();
+
+    while (g < shaped.size() && shaped[g].cluster < begin) {
+      g++;
+    }
+    if (g == shaped.size() || shaped[g].cluster >= end) {
+      if (pieces.empty()) {
+        return {};
+      }
+      continue;
+    }
+
+    const int x = origin + shaped[g].x;
+    if (!pieces.empty()) {
+      RunPiece &last = pieces.back();
+      last.src_w = x - last.src_x;
+      last.cells = glyphs[i].col - last.col;
+    }
+    pieces.push_back(RunPiece{x, 0, glyphs[i].col, 0});
+  }
+
+  if (!pieces.empty()) {
+    RunPiece &last = pieces.back();
+    last.src_w = std::numeric_limits<int>::max() - last.src_x;
+    last.cells = cells - last.col;
+  }
+  return pieces;
+}
+
+} // namespace gfx
@@ -0,0 +1,41 @@
+#pragma once
+#include <stdint.h>
+#include <vector>
+
+namespace gfx {
+
+struct ShapedGlyph {
+  // A glyph as placed by the shaper: the byte offset in the run's text of the
+  // cluster it belongs to, and the pen position it was drawn at, in pixels
+  // from the start of the run.
+  uint32_t cluster;
+  int x;
+};
+
+struct RunCell {
+  // A glyph of the grid in a run: the byte offset of its text in the run's,
+  // and its first cell, counted from the run's first.
+  int offset;
+  int col;
+};
+
+struct RunPiece {
+  // Part of a rasterized run, drawn over its own cells: pixels
+  // [src_x, src_x + src_w) of the run, over cells [col, col + cells). The
+  // last piece runs to the end of the run's pixels.
+  int src_x;
+  int src_w;
+  int col;
+  int cells;
+};
+
+std::vector<RunPiece> layout_run(const std::vector<ShapedGlyph> &shaped,
+                                 int origin,
+                                 const std::vector<RunCell> &glyphs,
+                                 int cells);
+// Map the clusters of a shaped run back to the cells of its glyphs, so each
+// is drawn in its own column whatever the font's advances. origin is how far
+// right of the pen's start the rasterized run begins. Glyphs the shaper joined into one cluster, as a ligature, become one
+// piece over all their cells. Empty if the first glyph has no cluster.
+
+} // namespace gfx
@@ -0,0 +1,72 @@
+#include "run_layout.hpp"
+
+#include <gtest/gtest.h>
+#include <vector>
+
+namespace {
+
+void expect_piece(const gfx::RunPiece &piece, int src_x, int src_w, int col,
+                  int cells) {
+  EXPECT_EQ(src_x, piece.src_x);
+  EXPECT_EQ(src_w, piece.src_w);
+  EXPECT_EQ(col, piece.col);
+  EXPECT_EQ(cells, piece.cells);
+}
+
+} // namespace
+
+TEST(RunLayout, OneClusterACell) {
+  // "abc", the font 7 pixels wide where the cells are 8: each glyph still
+  // goes to its own cell.
+  std::vector<gfx::ShapedGlyph> shaped{{0, 0}, {1, 7}, {2, 14}};
+  std::vector<gfx::RunCell> glyphs{{0, 0}, {1, 1}, {2, 2}};
+
+  auto pieces = gfx::layout_run(shaped, 0, glyphs, 3);
+  ASSERT_EQ(3u, pieces.size());
+  expect_piece(pieces[0], 0, 7, 0, 1);
+  expect_piece(pieces[1], 7, 7, 1, 1);
+  EXPECT_EQ(14, pieces[2].src_x);
+  EXPECT_EQ(2, pieces[2].col);
+  EXPECT_EQ(1, pieces[2].cells);
+
+  // Pixels left of the pen's start shift the run right.
+  pieces = gfx::layout_run(shaped, 2, glyphs, 3);
+  expect_piece(pieces[0], 2, 7, 0, 1);
+  expect_piece(pieces[1], 9, 7, 1, 1);
+}
+
+TEST(RunLayout, Ligature) {
+  // "->x", the arrow one glyph of the first cluster.
+  std::vector<gfx::ShapedGlyph> shaped{{0, 0}, {2, 16}};
+  std::vector<gfx::RunCell> glyphs{{0, 0}, {1, 1}, {2, 2}};
+
+  auto pieces = gfx::layout_run(shaped, 0, glyphs, 3);
+  ASSERT_EQ(2u, pieces.size());
+  expect_piece(pieces[0], 0, 16, 0, 2);
+  EXPECT_EQ(16, pieces[1].src_x);
+  EXPECT_EQ(2, pieces[1].col);
+  EXPECT_EQ(1, pieces[1].cells);
+}
+
+TEST(RunLayout, ClustersOfSeveralGlyphs) {
+  // A wide glyph, 3 bytes over 2 cells, then "e" and a combining acute drawn
+  // as two glyphs of one cluster, then "f".
+  std::vector<gfx::ShapedGlyph> shaped{{0, 0}, {3, 13}, {3, 20}, {6, 20}};
+  std::vector<gfx::RunCell> glyphs{{0, 0}, {3, 2}, {6, 3}};
+
+  auto pieces = gfx::layout_run(shaped, 0, glyphs, 4);
+  ASSERT_EQ(3u, pieces.size());
+  expect_piece(pieces[0], 0, 13, 0, 2);
+  expect_piece(pieces[1], 13, 7, 2, 1);
+  EXPECT_EQ(20, pieces[2].src_x);
+  EXPECT_EQ(3, pieces[2].col);
+}
+
+TEST(RunLayout, NothingToMap) {
+  std::vector<gfx::RunCell> glyphs{{0, 0}, {1, 1}};
+  EXPECT_TRUE(gfx::layout_run({}, 0, glyphs, 2).empty());
+
+  // The first glyph has no cluster of its own.
+  std::vector<gfx::ShapedGlyph> shaped{{1, 0}};
+  EXPECT_TRUE(gfx::layout_run(shaped, 0, glyphs, 2).empty());
+}
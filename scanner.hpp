@@ -0,0 +1,101 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define PEACHTERM_SCANNER_SSE2
+#endif
+
+#include "util.hpp"
+
+namespace parser {
+
+// Vectorised searches over the raw output of the child. Both return a
+// pointer to the first matching byte, or end if there is none.
+//
+// find_non_ascii:     first byte >= 0x80.
+// find_non_printable: first byte that is not printable ASCII, i.e. a C0
+//                     control (including ESC), DEL or any byte >= 0x80.
+
+namespace detail {
+
+inline bool is_printable(char c) {
+  return static_cast<unsigned char>(c) >= 0x20 &&
+         static_cast<unsigned char>(c) < 0x7f;
+}
+
+} // namespace detail
+
+inline const char *find_non_ascii(const char *begin, const char *end) {
+#if defined(__AVX2__)
+  for (; end - begin >= 32; begin += 32) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(begin));
+    uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(v));
+    if (mask) {
+      return begin + util::lowest_bit(mask);
+    }
+  }
+#elif defined(PEACHTERM_SCANNER_SSE2)
+  for (; end - begin >= 16; begin += 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(begin));
+    uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(v));
+    if (mask) {
+      return begin + util::lowest_bit(mask);
+    }
+  }
+#endif
+
+  for (; begin != end; ++begin) {
+    if (static_cast<unsigned char>(*begin) >= 0x80) {
+      break;
+    }
+  }
+
+  return begin;
+}
+
+inline const char *find_non_printable(const char *begin, const char *end) {
+  // As signed bytes, printable ASCII is exactly (0x1F, 0x7F).
+#if defined(__AVX2__)
+  const __m256i space = _mm256_set1_epi8(0x1F);
+  const __m256i del = _mm256_set1_epi8(0x7F);
+
+  for (; end - begin >= 32; begin += 32) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(begin));
+    __m256i printable = _mm256_andnot_si256(_mm256_cmpeq_epi8(v, del),
+                                            _mm256_cmpgt_epi8(v, space));
+    uint32_t mask = ~static_cast<uint32_t>(_mm256_movemask_epi8(printable));
+    if (mask) {
+      return begin + util::lowest_bit(mask);
+    }
+  }
+#elif defined(PEACHTERM_SCANNER_SSE2)
+  const __m128i space = _mm_set1_epi8(0x1F);
+  const __m128i del = _mm_set1_epi8(0x7F);
+
+  for (; end - begin >= 16; begin += 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(begin));
+    __m128i printable =
+        _mm_andnot_si128(_mm_cmpeq_epi8(v, del), _mm_cmpgt_epi8(v, space));
+    uint32_t mask =
+        ~static_cast<uint32_t>(_mm_movemask_epi8(printable)) & 0xFFFFu;
+    if (mask) {
+      return begin + util::lowest_bit(mask);
+    }
+  }
+#endif
+
+  for (; begin != end; ++begin) {
+    if (!detail::is_printable(*begin)) {
+      break;
+    }
+  }
+
+  return begin;
+}
+
+} // namespace parser
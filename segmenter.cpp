@@ -0,0 +1,93 @@
+#include "segmenter.hpp"
+
+namespace parser {
+
+namespace {
+
+size_t incomplete_tail(const char *data, size_t length) {
+  // Number of bytes at the end of data which start a UTF-8 sequence that
+  // is not yet complete.
+  for (size_t back = 1; back <= 3 && back <= length; back++) {
+    unsigned char c = data[length - back];
+
+    if ((c & 0xC0) == 0x80) {
+      continue; // continuation byte, keep looking for the lead.
+    }
+
+    size_t expected = (c & 0xE0) == 0xC0   ? 2
+                      : (c & 0xF0) == 0xE0 ? 3
+                      : (c & 0xF8) == 0xF0 ? 4
+                                           : 1;
+
+    return expected > back ? back : 0;
+  }
+
+  return 0;
+}
+
+} // namespace
+
+const char *Segmenter::segment(const char *data, size_t length,
+                               bool at_end) {
+  breaks.clear();
+
+  const size_t tail = at_end ? incomplete_tail(data, length) : 0;
+  const char *tail_begin = data + length - tail;
+
+  size_t complete = length - tail;
+
+  if (!unicode::is_valid_utf8(data, complete)) {
+    replaced.clear();
+    unicode::replace_invalid_utf8(data, complete, replaced);
+
+    data = replaced.data();
+    complete = replaced.size();
+  }
+
+  breaker.reset();
+
+  const char *pos = data;
+  const char *end = data + complete;
+
+  while (pos != end) {
+    const char *start = pos;
+    uint32_t cp = unicode::decode_utf8(pos, end);
+
+    if (breaker.breaks_before(unicode::properties(cp)) && start != data) {
+      breaks.push_back(static_cast<int32_t>(start - data));
+    }
+  }
+
+  if (complete > 0) {
+    breaks.push_back(static_cast<int32_t>(complete));
+  }
+
+  if (!at_end) {
+    return data;
+  }
+
+  // The next chunk may extend the last cluster, so it waits for it.
+  size_t keep = complete;
+
+  if (!breaks.empty()) {
+    breaks.pop_back();
+    keep = breaks.empty() ? 0 : static_cast<size_t>(breaks.back());
+  }
+
+  pending.assign(data + keep, complete - keep);
+  pending.append(tail_begin, tail);
+
+  return data;
+}
+
+const char *Segmenter::finish() {
+  joined.swap(pending);
+
+  const size_t tail = incomplete_tail(joined.data(), joined.size());
+  const size_t complete = joined.size() - tail;
+  pending.assign(joined.data() + complete, tail);
+
+  return segment(joined.data(), complete, false);
+}
+
+} // namespace parser
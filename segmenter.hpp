@@ -0,0 +1,144 @@
+#pragma once
+
+#include <algorithm>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "scanner.hpp"
+#include "unicode.hpp"
+
+namespace parser {
+
+class Segmenter {
+  // Splits the output of the child into grapheme clusters. Runs of ASCII
+  // never reach the breaker, only spans containing non-ASCII bytes are
+  // segmented. Each span is validated first, and any invalid UTF-8 in it
+  // is replaced with U+FFFD.
+  //
+  // The next chunk may always extend the last cluster of this one, with a
+  // combining mark, a ZWJ sequence or the second half of a flag, and a chunk
+  // may end part way through a UTF-8 sequence. So text ending a chunk is
+  // kept in `pending`, down to a final printable ASCII character, and joined
+  // onto the start of the next chunk. A control byte or ASCII starting the
+  // next chunk shows it's finished, as does a flush.
+  unicode::GraphemeBreaker breaker;
+
+  std::string pending;
+  std::string joined;
+  std::string replaced;
+  std::vector<int32_t> breaks;
+
+public:
+  template <typename AsciiFn, typename ClusterFn>
+  void feed(const char *input, size_t length, AsciiFn &&on_ascii,
+            ClusterFn &&on_cluster);
+  // Calls on_ascii(data, length) for each run of ASCII and
+  // on_cluster(data, length) for every other grapheme cluster, in order.
+
+  template <typename AsciiFn, typename ClusterFn>
+  void flush(AsciiFn &&on_ascii, ClusterFn &&on_cluster);
+  // Hand over the text kept back from the last chunk, as nothing more is
+  // coming for now. An unfinished UTF-8 sequence is still kept.
+
+private:
+  const char *segment(const char *data, size_t length, bool at_end);
+  // Fills `breaks` with the end offsets of the clusters in data. If at_end,
+  // the last cluster and any unfinished tail are moved to `pending` instead.
+  // Returns the text the offsets refer to: data itself, or a copy with
+  // invalid UTF-8 replaced.
+  const char *finish();
+  // Segment all of `pending` but an unfinished tail, as for segment.
+
+  template <typename ClusterFn>
+  void emit(const char *data, ClusterFn &&on_cluster);
+  // Call on_cluster for each cluster found by segment.
+};
+
+template <typename ClusterFn>
+inline void Segmenter::emit(const char *data, ClusterFn &&on_cluster) {
+  int32_t last = 0;
+  for (int32_t pos : breaks) {
+    on_cluster(data + last, static_cast<size_t>(pos - last));
+    last = pos;
+  }
+}
+
+template <typename AsciiFn, typename ClusterFn>
+inline void Segmenter::flush(AsciiFn &&on_ascii, ClusterFn &&on_cluster) {
+  if (pending.size() == 1 && static_cast<unsigned char>(pending[0]) < 0x80) {
+    char c = pending[0];
+    pending.clear();
+    on_ascii(&c, 1u);
+    return;
+  }
+
+  if (!pending.empty()) {
+    emit(finish(), on_cluster);
+  }
+}
+
+template <typename AsciiFn, typename ClusterFn>
+inline void Segmenter::feed(const char *input, size_t length,
+                            AsciiFn &&on_ascii, ClusterFn &&on_cluster) {
+  auto is_ascii = [](char c) { return static_cast<unsigned char>(c) < 0x80; };
+  auto is_print = [](char c) { return c >= 0x20 && c < 0x7f; };
+
+  const char *pos = input;
+  const char *end = input + length;
+
+  if (pos == end) {
+    return;
+  }
+
+  if (!pending.empty()) {
+    // Finish what the last chunk started. ASCII always begins a new cluster,
+    // so the head of this chunk extends pending only up to the first one.
+    const char *head = std::find_if(pos, end, is_ascii);
+
+    if (head == pos) {
+      flush(on_ascii, on_cluster);
+    } else {
+      joined.assign(pending);
+      joined.append(pos, head);
+      pending.clear();
+
+      emit(segment(joined.data(), joined.size(), head == end), on_cluster);
+      pos = head;
+    }
+  }
+
+  while (pos != end) {
+    const char *run = find_non_ascii(pos, end);
+
+    if (run == end) {
+      // A printable character ending the chunk may be the base of marks at
+      // the start of the next.
+      const char *tail = is_print(end[-1]) ? end - 1 : end;
+      if (tail != pos) {
+        on_ascii(pos, static_cast<size_t>(tail - pos));
+      }
+      pending.assign(tail, end);
+      return;
+    }
+
+    // A printable character may be the base of the marks that follow it.
+    const char *span = run;
+    if (span != pos && is_print(span[-1])) {
+      --span;
+    }
+
+    if (span != pos) {
+      on_ascii(pos, static_cast<size_t>(span - pos));
+    }
+
+    const char *span_end = std::find_if(run, end, is_ascii);
+
+    size_t span_length = static_cast<size_t>(span_end - span);
+    emit(segment(span, span_length, span_end == end), on_cluster);
+    pos = span_end;
+  }
+}
+
+} // namespace parser
@@ -0,0 +1,100 @@
+#include "shaper.hpp"
+#include "text_renderer.h"
+
+#include <algorithm>
+#include <ft2build.h>
+#include FT_FREETYPE_H
+#include <hb-ft.h>
+#include <hb.h>
+#include <iostream>
+
+namespace gfx {
+
+namespace {
+
+// Positions are in 26.6 fixed point, as FreeType's.
+int to_pixels(hb_position_t position) { return (position + 32) >> 6; }
+
+} // namespace
+
+Shaper::Shaper(const FontSpec &spec) {
+  if (FT_Init_FreeType(&library) != 0) {
+    std::cerr << "Unable to start FreeType, runs won't be shaped" << std::endl;
+    library = nullptr;
+    return;
+  }
+
+  buffer = hb_buffer_create();
+
+  const std::string *data[] = {&spec.regular, &spec.italic, &spec.bold,
+                               &spec.bolditalic};
+  for (size_t i = 0; i < fonts.size(); i++) {
+    FT_Face face = nullptr;
+    if (FT_New_Memory_Face(library,
+                           reinterpret_cast<const FT_Byte *>(data[i]->data()),
+                           static_cast<FT_Long>(data[i]->size()), 0,
+                           &face) != 0) {
+      continue;
+    }
+
+    // Sized as SDL_ttf sizes a font opened at a point size, at 72 dpi, so
+    // the advances come out the same.
+    FT_Set_Char_Size(face, 0, spec.pointsize * 64, 0, 0);
+    fonts[i] = Font{face, hb_ft_font_create_referenced(face)};
+  }
+}
+
+Shaper::~Shaper() {
+  for (Font &font : fonts) {
+    if (font.font != nullptr) {
+      hb_font_destroy(font.font);
+    }
+    if (font.face != nullptr) {
+      FT_Done_Face(font.face);
+    }
+  }
+  if (buffer != nullptr) {
+    hb_buffer_destroy(buffer);
+  }
+  if (library != nullptr) {
+    FT_Done_FreeType(library);
+  }
+}
+
+bool Shaper::shape(int font, std::string_view text,
+                   std::vector<ShapedGlyph> &out, int &origin) {
+  out.clear();
+  if (font < 0 || font >= static_cast<int>(fonts.size()) ||
+      fonts[font].font == nullptr) {
+    return false;
+  }
+  hb_font_t *hb_font = fonts[font].font;
+
+  // As SDL_ttf shapes: left to right, in logical order, the script guessed.
+  hb_buffer_clear_contents(buffer);
+  hb_buffer_add_utf8(buffer, text.data(), static_cast<int>(text.size()), 0,
+                     static_cast<int>(text.size()));
+  hb_buffer_set_direction(buffer, HB_DIRECTION_LTR);
+  hb_buffer_guess_segment_properties(buffer);
+  hb_shape(hb_font, buffer, nullptr, 0);
+
+  unsigned int count = 0;
+  const hb_glyph_info_t *info = hb_buffer_get_glyph_infos(buffer, &count);
+  const hb_glyph_position_t *pos = hb_buffer_get_glyph_positions(buffer, &count);
+
+  hb_position_t pen = 0;
+  hb_position_t min_x = 0;
+  for (unsigned int i = 0; i < count; i++) {
+    hb_glyph_extents_t extents;
+    if (hb_font_get_glyph_extents(hb_font, info[i].codepoint, &extents)) {
+      min_x = std::min(min_x, pen + pos[i].x_offset + extents.x_bearing);
+    }
+    out.push_back(ShapedGlyph{info[i].cluster, to_pixels(pen)});
+    pen += pos[i].x_advance;
+  }
+
+  origin = to_pixels(-min_x);
+  return true;
+}
+
+} // namespace gfx
@@ -0,0 +1,45 @@
+#pragma once
+#include <array>
+#include <string_view>
+#include <vector>
+
+#include "run_layout.hpp"
+
+struct FT_LibraryRec_;
+struct FT_FaceRec_;
+struct hb_font_t;
+struct hb_buffer_t;
+
+namespace gfx {
+
+class FontSpec;
+
+class Shaper {
+  // Shapes runs with HarfBuzz, as SDL_ttf does when it rasterizes them, to
+  // find where it drew each cluster. Has its own FreeType faces, from the
+  // same font data and at the same size as the renderer's.
+  struct Font {
+    FT_FaceRec_ *face = nullptr;
+    hb_font_t *font = nullptr;
+  };
+
+  FT_LibraryRec_ *library = nullptr;
+  std::array<Font, 4> fonts; // as Rasterizer::Fonts
+  hb_buffer_t *buffer = nullptr;
+
+public:
+  explicit Shaper(const FontSpec &spec);
+  // The spec's font data must outlive the shaper.
+  ~Shaper();
+
+  Shaper(const Shaper &) = delete;
+  Shaper &operator=(const Shaper &) = delete;
+
+  bool shape(int font, std::string_view text, std::vector<ShapedGlyph> &out,
+             int &origin);
+  // Shape text in the font at index font, into its glyphs in logical order.
+  // origin is how far right the rasterized text is moved, so glyphs reaching
+  // left of the pen's start fit. False if the font couldn't be loaded.
+};
+
+} // namespace gfx
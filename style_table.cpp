@@ -0,0 +1,47 @@
+#include "style_table.hpp"
+
+namespace gfx {
+
+StyleTable::StyleTable() {
+  entries.emplace_back();
+  table.emplace_back();
+  lookup.emplace(Style{}, 0);
+  table_version++;
+}
+
+uint32_t StyleTable::intern(const Style &style) {
+  auto found = lookup.find(style);
+  if (found != lookup.end()) {
+    uint32_t index = found->second;
+    return entries[index].generation << generation_shift | index;
+  }
+
+  uint32_t index;
+  if (!free_slots.empty()) {
+    index = free_slots.back();
+    free_slots.pop_back();
+  } else if (entries.size() <= index_mask) {
+    index = static_cast<uint32_t>(entries.size());
+    entries.emplace_back();
+    table.emplace_back();
+  } else {
+    // Out of ids.
+    return 0;
+  }
+
+  table[index] = style;
+  lookup.emplace(style, index);
+  table_version++;
+
+  return entries[index].generation << generation_shift | index;
+}
+
+void StyleTable::free(uint32_t index) {
+  lookup.erase(table[index]);
+
+  entries[index].generation =
+      (entries[index].generation + 1) & (0xFFFFFFFF >> generation_shift);
+  free_slots.push_back(index);
+}
+
+} // namespace gfx
@@ -0,0 +1,78 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+
+#include "termcell.hpp"
+
+namespace gfx {
+
+class StyleTable {
+  // Hash-conses the styles set by SGR, so every cell drawn the same way
+  // shares one id. Entries are reference counted by the cells using them and
+  // by the current pen. A freed slot is reused with a new generation, so a
+  // stale id never equals a new one.
+  //
+  // id: generation: 16 | index: 16
+  struct Entry {
+    uint32_t refs = 0;
+    uint32_t generation = 0;
+  };
+
+  struct Hash {
+    size_t operator()(const Style &s) const {
+      uint64_t h = (uint64_t{s.fg_col} << 32 | s.bg_col) ^ s.attrs;
+      h *= 0x9E3779B97F4A7C15ull;
+      return static_cast<size_t>(h ^ h >> 32);
+    }
+  };
+
+  std::vector<Entry> entries;
+  std::vector<Style> table;
+  std::unordered_map<Style, uint32_t, Hash> lookup;
+  std::vector<uint32_t> free_slots;
+
+  uint64_t table_version = 0;
+
+public:
+  static constexpr uint32_t index_mask = 0xFFFF;
+  static constexpr int generation_shift = 16;
+
+  StyleTable();
+
+  StyleTable(const StyleTable &) = delete;
+  StyleTable &operator=(const StyleTable &) = delete;
+
+  uint32_t intern(const Style &style);
+  // The id of style. The entry starts with no references, it lives until the
+  // last release. The default style is id 0, it isn't counted and is never
+  // freed.
+
+  void retain(uint32_t id, uint32_t count = 1) {
+    if (id != 0) {
+      entries[index(id)].refs += count;
+    }
+  }
+
+  void release(uint32_t id) {
+    if (id != 0 && --entries[index(id)].refs == 0) {
+      free(index(id));
+    }
+  }
+
+  static uint32_t index(uint32_t id) { return id & index_mask; }
+
+  const std::vector<Style> &styles() const { return table; }
+  // Each style, by index.
+
+  uint64_t version() const { return table_version; }
+  // Changes whenever an entry is added.
+
+  size_t size() const { return lookup.size(); }
+
+private:
+  void free(uint32_t index);
+};
+
+} // namespace gfx
@@ -0,0 +1,74 @@
+#include "style_table.hpp"
+
+#include <gtest/gtest.h>
+
+TEST(StyleTable, Intern) {
+  gfx::StyleTable table;
+
+  EXPECT_EQ(0u, table.intern(gfx::Style{}));
+
+  gfx::Style bold;
+  bold.set(gfx::Style::Attr::BOLD, true);
+
+  uint32_t a = table.intern(bold);
+  uint32_t b = table.intern(bold);
+  EXPECT_NE(0u, a);
+  EXPECT_EQ(a, b);
+  EXPECT_EQ(bold, table.styles()[gfx::StyleTable::index(a)]);
+
+  table.retain(a);
+  table.release(a);
+
+  // The slot is reused, but never by an equal id.
+  gfx::Style red;
+  red.fg_col = 0xFF0000FF;
+  uint32_t c = table.intern(red);
+  EXPECT_EQ(gfx::StyleTable::index(a), gfx::StyleTable::index(c));
+  EXPECT_NE(a, c);
+
+  // The default style isn't counted.
+  table.release(0);
+  EXPECT_EQ(0u, table.intern(gfx::Style{}));
+  EXPECT_EQ(2u, table.size());
+}
+
+TEST(StyleTable, CountedReferences) {
+  gfx::StyleTable table;
+
+  gfx::Style italic;
+  italic.set(gfx::Style::Attr::ITALIC, true);
+  uint32_t id = table.intern(italic);
+
+  // As put_text does, several cells retained at once.
+  table.retain(id, 3);
+  table.release(id);
+  table.release(id);
+  EXPECT_EQ(id, table.intern(italic));
+
+  table.release(id);
+  EXPECT_EQ(1u, table.size());
+  EXPECT_NE(id, table.intern(italic));
+}
+
+TEST(StyleTable, Version) {
+  gfx::StyleTable table;
+  uint64_t version = table.version();
+
+  gfx::Style underline;
+  underline.set(gfx::Style::Attr::UNDERLINE, true);
+
+  // Only adding a style changes the version, finding one doesn't.
+  uint32_t id = table.intern(underline);
+  EXPECT_NE(version, table.version());
+  version = table.version();
+
+  EXPECT_EQ(id, table.intern(underline));
+  EXPECT_EQ(version, table.version());
+
+  // Styles differing only in colour are distinct.
+  gfx::Style blue = underline;
+  blue.bg_col = 0x0000FFFF;
+  EXPECT_NE(gfx::StyleTable::index(id),
+            gfx::StyleTable::index(table.intern(blue)));
+  EXPECT_EQ(3u, table.size());
+}
@@ -1,21 +1,66 @@
 #pragma once
-#include <string>
-#include <tuple>
 #include <stdint.h>
+#include <string.h>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "unicode.hpp"
 
 namespace gfx {
-struct TermCell {
-  std::string glyph = " ";
-  uint32_t fg_col = 0xFFFFFFFF;
-  uint32_t bg_col = 0x000000FF;
-  bool bold = false;
-  bool italic = false;
-  bool overline = false;
-  bool underline = false;
-  bool dunderline = false;
-  bool strike = false;
-  bool feint = false;
-  bool reverse = false;
+
+class Glyph {
+  // What a cell shows: a single code point stored inline, or a handle to a
+  // cluster of several code points in the GraphemePool. The second cell of a
+  // wide glyph is empty.
+  //
+  // pooled: 1 | generation: 11 | index: 20
+  uint32_t bits;
+
+  constexpr explicit Glyph(uint32_t b, int) : bits{b} {}
+
+public:
+  static constexpr uint32_t pooled_bit = 1u << 31;
+  static constexpr int generation_shift = 20;
+  static constexpr uint32_t generation_mask = 0x7FF;
+  static constexpr uint32_t index_mask = (1u << generation_shift) - 1;
+
+  constexpr Glyph() : bits{' '} {}
+
+  static constexpr Glyph empty() { return Glyph{0, 0}; }
+  static constexpr Glyph code_point(uint32_t cp) { return Glyph{cp, 0}; }
+  static constexpr Glyph pooled(uint32_t index, uint32_t generation) {
+    return Glyph{pooled_bit | (generation & generation_mask) << generation_shift |
+                     index,
+                 0};
+  }
+
+  bool is_empty() const { return bits == 0; }
+  bool is_pooled() const { return bits & pooled_bit; }
+  uint32_t code_point() const { return bits; }
+  uint32_t index() const { return bits & index_mask; }
+  uint32_t generation() const {
+    return (bits >> generation_shift) & generation_mask;
+  }
+
+  friend bool operator==(Glyph l, Glyph r) { return l.bits == r.bits; }
+  friend bool operator!=(Glyph l, Glyph r) { return l.bits != r.bits; }
+};
+
+// Colours are packed as 0xRRGGBB in the top 24 bits, with a tag in the low
+// byte saying where they came from.
+enum ColourTag : uint32_t {
+  COLOUR_DEFAULT = 0x00, // the terminal's default foreground or background
+  COLOUR_SET = 0xFF,     // set by SGR
+};
+
+struct Style {
+  // How a cell is drawn, the state set by SGR. Cells refer to their style by
+  // an id into the grid's StyleTable.
+  uint32_t fg_col = 0xFFFFFF00 | COLOUR_DEFAULT;
+  uint32_t bg_col = 0x00000000 | COLOUR_DEFAULT;
+  uint16_t attrs = 0;
+  uint16_t spare = 0; // kept zero, so styles compare bytewise
 
 public:
   enum class Attr {
@@ -31,17 +76,54 @@ public:
     REVERSE
   };
 
+  bool has(Attr attr) const { return attrs & bit(attr); }
+  void set(Attr attr, bool value) {
+    attrs = value ? attrs | bit(attr) : attrs & ~bit(attr);
+  }
+
+  friend inline bool operator==(const Style &l, const Style &r) {
+    return memcmp(&l, &r, sizeof(Style)) == 0;
+  }
+
+  friend inline bool operator!=(const Style &l, const Style &r) {
+    return !(l == r);
+  }
+
+private:
+  static uint16_t bit(Attr attr) {
+    return static_cast<uint16_t>(1u << static_cast<int>(attr));
+  }
+};
+
+struct TermCell {
+  Glyph glyph;
+  uint32_t style = 0; // see StyleTable, 0 is the default style
+
   friend inline bool operator==(const TermCell &l, const TermCell &r) {
-    return std::tie(l.fg_col, l.bg_col, l.bold, l.italic, l.overline, 
-                    l.underline, l.dunderline, l.strike, l.feint, 
-                    l.reverse, l.glyph) ==
-           std::tie(r.fg_col, r.bg_col, r.bold, r.italic, l.overline, 
-                    r.underline, r.dunderline, r.strike, r.feint, 
-                    r.reverse, r.glyph);
+    return l.glyph == r.glyph && l.style == r.style;
   }
 
   friend inline bool operator!=(const TermCell &l, const TermCell &r) {
     return !(l == r);
   }
 };
-} // namespace Gfx
\ No newline at end of file
+
+static_assert(sizeof(TermCell) == 8, "cells are packed into 8 bytes");
+
+inline std::string_view glyph_text(Glyph glyph,
+                                   const std::vector<std::string> &pooled,
+                                   char (&utf8)[4]) {
+  // The UTF-8 text of glyph. Pooled clusters are looked up in pooled, single
+  // code points are encoded into utf8.
+  if (glyph.is_pooled()) {
+    // Both views, so the pooled text isn't copied into a temporary.
+    return glyph.index() < pooled.size()
+               ? std::string_view{pooled[glyph.index()]}
+               : std::string_view{" "};
+  }
+  if (glyph.is_empty()) {
+    return {};
+  }
+  return {utf8, unicode::encode_utf8(glyph.code_point(), utf8)};
+}
+} // namespace gfx
@@ -13,68 +13,41 @@ TermHistory::TermHistory(std::string filename) {
 
   std::cout << "Using file for history: " << filename << std::endl;
 
-  start_row();
-  gfx::TermCell cell;
-  cell.glyph = "H", add_cell_to_history(cell);
-  cell.glyph = "e", add_cell_to_history(cell);
-  cell.glyph = "l", add_cell_to_history(cell);
-  cell.glyph = "l", add_cell_to_history(cell);
-  cell.glyph = "o", add_cell_to_history(cell);
-  cell.glyph = ".", add_cell_to_history(cell);
-  finish_row();
+  pending = "Hello.\n";
 }
 
-void TermHistory::start_row() { buff.clear(); }
+TermHistory::~TermHistory() { flush(); }
+
+void TermHistory::finish_row(size_t row_begin, size_t row_end) {
+  pending.resize(row_end);
+  pending += '\n';
 
-void TermHistory::finish_row() {
 #ifdef PEACHTERM_IS_VERBOSE
-  std::cout << "Row is history  =|";
-  for (auto &c : buff) {
-    if (c.glyph.size() != 1) {
-      std::cout << " ";
-    }
-    if (!std::isprint(*c.glyph.data())) {
-      std::cout << " ";
-    }
-    std::cout << c.glyph;
-  }
-  std::cout << std::endl;
+  std::cout << "Row is history  =|"
+            << std::string_view{pending}.substr(row_begin,
+                                                row_end - row_begin)
+            << std::endl;
+#else
+  static_cast<void>(row_begin);
 #endif
 
+  if (pending.size() >= flush_size) {
+    flush();
+  }
+}
+
+void TermHistory::flush() {
   if (!history_file) {
+    pending.clear();
     return;
   }
 
   history_file.seekp(0, std::fstream::end);
-  size_t trim = 0;
-  for (auto i = buff.rbegin(); i != buff.rend(); ++i) {
-    // Excluding unicode magic, if the char is a whitespace trim it.
-    if (i->glyph.size() == 1 && !iswspace(i->glyph[0])) {
-      break;
-    }
-    if (i->glyph.size() > 1) {
-      break;
-    }
-    trim++;
-  }
-
-#ifdef PEACHTERM_IS_VERBOSE
-  std::cout << "History line: " << buff.size() << std::endl;
-  std::cout << "History line post-trim: " << buff.size() - trim << std::endl;
-#endif
-
-  for (size_t i = 0; i < buff.size() - trim; ++i) {
-    history_file.write(buff[i].glyph.data(), buff[i].glyph.size());
-  }
-
-  history_file << "\n";
+  history_file.write(pending.data(), pending.size());
   history_file.flush();
+  pending.clear();
 
   if (!history_file) {
     std::cerr << "Error after writing history file." << std::endl;
   }
 }
-
-void TermHistory::add_cell_to_history(const gfx::TermCell &cell) {
-  buff.push_back(cell);
-}
\ No newline at end of file
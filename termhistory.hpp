@@ -1,33 +1,53 @@
 #pragma once
 
+#include <cwctype>
+#include <iterator>
 #include <type_traits>
+#include <string>
 #include <vector>
 #include <fstream>
 
 #include "termcell.hpp"
 
 class TermHistory {
-    std::vector<gfx::TermCell> buff;
+    std::string pending; // rows not yet written to the file
     std::ofstream history_file;
 
+    static constexpr size_t flush_size = 64 * 1024;
+
 public:
     TermHistory(std::string filename="history.log");
+    ~TermHistory();
     template<typename It>
-    void add_row_to_history(It lineBegin, It lineEnd);
+    void add_row_to_history(It lineBegin, It lineEnd,
+                            const std::vector<std::string> &pooled);
+    // pooled resolves the glyphs of the cells, see gfx::glyph_text. Rows are
+    // buffered and written out a batch at a time.
+
+    void flush();
+    // Write out the buffered rows.
 
 private:
-    void start_row();
-    void add_cell_to_history(const gfx::TermCell&);
-    void finish_row();
+    void finish_row(size_t row_begin, size_t row_end);
 };
 
 template<typename It>
-inline void TermHistory::add_row_to_history(It lineBegin, It lineEnd) {
-    //static_assert(std::is_same_v<It::value_type, gfx::TermCell>);
+inline void TermHistory::add_row_to_history(It lineBegin, It lineEnd,
+                                            const std::vector<std::string> &pooled) {
+    static_assert(std::is_same_v<typename std::iterator_traits<It>::value_type,
+                                 gfx::TermCell>);
 
-    start_row();
-    for(auto& c=lineBegin; c != lineEnd; ++c) {
-        add_cell_to_history(c->value());
+    // The text goes straight into the buffer. Trailing blanks are trimmed, so
+    // the row ends after its last cell with something in it.
+    const size_t row_begin = pending.size();
+    size_t row_end = row_begin;
+    char utf8[4];
+    for(auto c=lineBegin; c != lineEnd; ++c) {
+        std::string_view text = gfx::glyph_text(c->glyph, pooled, utf8);
+        pending.append(text);
+        if (text.size() > 1 || (text.size() == 1 && !iswspace(text[0]))) {
+            row_end = pending.size();
+        }
     }
-    finish_row();
-}
\ No newline at end of file
+    finish_row(row_begin, row_end);
+}
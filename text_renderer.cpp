@@ -1,29 +1,72 @@
 #include "text_renderer.h"
+#include "box_drawing.hpp"
+#include "mapped_file.hpp"
+#include "unicode.hpp"
 #include <SDL.h>
 #include <SDL_ttf.h>
+#include <algorithm>
 #include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <string.h>
 #include <string_view>
+#include <thread>
 #include <utility>
 
 //#define DEBUG_CACHE
 
-bool operator==(const SDL_Color &a, const SDL_Color &b) {
-  auto &&t = [](auto &&a) { return std::tie(a.a, a.r, a.g, a.b); };
-  return t(a) == t(b);
-}
-
 namespace {
 
 SDL_RWops *RW_FromString(const std::string &data) {
   return SDL_RWFromConstMem(data.data(), static_cast<int>(data.size()));
 }
+
+// FNV-1a, a word at a time, for hashing whole font files quickly.
+uint64_t hash_bytes(uint64_t h, const std::string &data) {
+  constexpr uint64_t prime = 0x100000001B3ull;
+
+  size_t i = 0;
+  for (; i + 8 <= data.size(); i += 8) {
+    uint64_t word;
+    memcpy(&word, data.data() + i, 8);
+    h = (h ^ word) * prime;
+  }
+  for (; i < data.size(); i++) {
+    h = (h ^ static_cast<unsigned char>(data[i])) * prime;
+  }
+  return (h ^ data.size()) * prime;
+}
+
+// The glyph cache file: a header, then each glyph's record followed by its
+// text and its coverage, one byte a pixel.
+constexpr char disk_magic[8] = {'P', 'T', 'G', 'L', 'Y', 'P', 'H', '1'};
+
+struct DiskHeader {
+  char magic[8];
+  uint64_t key; // of the font data and point size
+  uint32_t count;
+  uint32_t spare;
+};
+
+struct DiskGlyph {
+  uint8_t font; // bold * 2 + italic
+  uint8_t length;
+  uint16_t w;
+  uint16_t h;
+};
+
 } // namespace
 
 namespace gfx {
 
 void TextRenderer::load_fonts(SDL_Renderer *ren, const FontSpec &spec) {
+  // Keep what the old fonts rasterized, before they're closed.
+  save_disk_cache();
+
   if (fontRegular != 0) {
     TTF_CloseFont(fontRegular);
   }
@@ -55,6 +98,7 @@ void TextRenderer::load_fonts(SDL_Renderer *ren, const FontSpec &spec) {
                    &advance);
 
   font_height = TTF_FontHeight(fontRegular);
+  font_ascent = TTF_FontAscent(fontRegular);
 
   cell_height = font_height;
   cell_width = advance;
@@ -62,30 +106,51 @@ void TextRenderer::load_fonts(SDL_Renderer *ren, const FontSpec &spec) {
 
   std::cout << "Loaded fonts\n";
 
-  if (cacheTex) {
-    SDL_DestroyTexture(cacheTex);
+  // Pages hold a good number of glyphs of this size, and the longest run.
+  page_size = 1024;
+  while (page_size < std::max(16 * std::max(cell_width, cell_height),
+                              max_run_cells * cell_width)) {
+    page_size *= 2;
   }
 
-  cacheTex = SDL_CreateTexture(
-      ren, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET,
-      cache_width_cells * cell_width, cache_height_cells * cell_height);
+  clear_pages();
 
-  lru_map.clear();
-  lru_list.clear();
+  std::cout << "Cleared cell cache\n";
 
-  SDL_Color black;
-  black.r = black.g = black.b = 0;
-  black.a = 255;
-  for (int i = 0; i < cache_height_cells * cache_width_cells; i++) {
-    auto key =
-        std::make_tuple((TTF_Font *)nullptr, black, black, std::string{" "});
-    lru_list.push_front(std::make_pair(key, i));
+  // The main thread rasterizes too, and the parser has a core of its own.
+  int cores = static_cast<int>(std::thread::hardware_concurrency());
+  int workers = std::clamp(cores - 2, 0, 4);
+  rasterizer.reset();
+  rasterizer = std::make_unique<Rasterizer>(spec, workers);
+  shaper.reset();
+  shaper = std::make_unique<Shaper>(spec);
+  layouts.clear();
+
+  // Start with the glyphs rasterized by an earlier run, with these fonts.
+  disk_cache_key = 0xCBF29CE484222325ull;
+  for (const std::string *data :
+       {&spec.regular, &spec.italic, &spec.bold, &spec.bolditalic}) {
+    disk_cache_key = hash_bytes(disk_cache_key, *data);
+  }
+  disk_cache_key = (disk_cache_key ^ static_cast<uint64_t>(spec.pointsize)) *
+                   0x100000001B3ull;
+
+  disk_cache_path.clear();
+  std::string dir = io::cache_directory();
+  if (!dir.empty()) {
+    char name[32];
+    snprintf(name, sizeof(name), "glyphs-%016llx.bin",
+             static_cast<unsigned long long>(disk_cache_key));
+    disk_cache_path = dir + "/" + name;
+    load_disk_cache(ren);
   }
 
-  std::cout << "Cleared cell cache\n";
+  prewarm_next = 0;
 }
 
 TextRenderer::~TextRenderer() {
+  save_disk_cache();
+
   std::cout << "Destroying fonts\n";
 
   if (fontRegular) {
@@ -101,11 +166,11 @@ TextRenderer::~TextRenderer() {
     TTF_CloseFont(fontBoldItalic);
   }
 
+  rasterizer.reset();
+
   std::cout << "Destroying cell cache\n";
 
-  if (cacheTex) {
-    SDL_DestroyTexture(cacheTex);
-  }
+  clear_pages();
 }
 
 TTF_Font *TextRenderer::get_font(bool bold, bool italic) const {
@@ -124,158 +189,595 @@ TTF_Font *TextRenderer::get_font(bool bold, bool italic) const {
   return font;
 }
 
+Rasterizer::Fonts TextRenderer::fonts() const {
+  return {fontRegular, fontRegularItalic, fontBold, fontBoldItalic};
+}
+
+int TextRenderer::font_index(const void *font) const {
+  const Rasterizer::Fonts all = fonts();
+  return static_cast<int>(std::find(all.begin(), all.end(), font) -
+                          all.begin()) & 3;
+}
+
 std::pair<int, int> TextRenderer::cell_size() const {
   return {cell_width, cell_height};
 }
 
-void TextRenderer::draw_character(SDL_Renderer *ren, TTF_Font *font,
-                                  std::string_view glyph, const SDL_Color &fg,
-                                  const SDL_Color &bg, int top, int left) {
-  // Rectangle for the cell. in screen space.
-  SDL_Rect cell_rect;
-  cell_rect.x = left;
-  cell_rect.y = top;
-  // width and height as yet unknown
-
-  auto [cache_index, is_hit] = get_cache_location(font, glyph, fg, bg);
-
-  SDL_Rect cached_cell_rect;
-  cached_cell_rect.x = (cache_index % cache_width_cells) * cell_width;
-  cached_cell_rect.y = (cache_index / cache_height_cells) * cell_height;
-  cached_cell_rect.w = cell_rect.w = cell_width;
-  cached_cell_rect.h = cell_rect.h = cell_height;
-
-  if (is_hit) {
-    SDL_RenderCopy(ren, cacheTex, &cached_cell_rect, &cell_rect);
+void TextRenderer::draw_character(TTF_Font *font, std::string_view glyph,
+                                  const SDL_Color &fg, int top, int left) {
+  if (glyph.empty() || glyph == " ") {
     return;
   }
 
-  // Begin draw character.
-  SDL_Surface *cellSurf = TTF_RenderUTF8_Shaded(font, glyph.data(), fg, bg);
-  SDL_Texture *cellTex = SDL_CreateTextureFromSurface(ren, cellSurf);
+  // Box drawing is drawn to fit the cell exactly, rather than from the font,
+  // the same in every style.
+  uint32_t box = 0;
+  if (glyph.size() == 3 && glyph[0] == '\xE2') {
+    const char *pos = glyph.data();
+    uint32_t cp = unicode::decode_utf8(pos, glyph.data() + glyph.size());
+    if (is_box_drawing(cp)) {
+      box = cp;
+    }
+  }
+  if (box) {
+    if (const GlyphCache::Entry *entry = cache.find(&box_key, glyph)) {
+      ++cache_hits;
+      draw_glyph(*entry, fg, top, left);
+      return;
+    }
 
-  // Read back the size of the character
-  SDL_QueryTexture(cellTex, nullptr, nullptr, &cell_rect.w, &cell_rect.h);
+    ++cache_misses;
+    box_misses.push_back(BoxMiss{box, Miss{0, fg, top, left, nullptr}});
+    return;
+  }
 
-  SDL_RenderCopy(ren, cellTex, NULL, &cell_rect);
+  // Wide glyphs, and those overhanging their cell, are drawn whole.
+  draw_text(font, glyph, fg, top, left, nullptr);
+}
 
-  // Caching
-  if (cacheTex != nullptr) {
-    // Rememebr previous render target
-    SDL_Texture *prevTexTarget = SDL_GetRenderTarget(ren);
+void TextRenderer::draw_run(TTF_Font *font, std::string_view text,
+                            const std::vector<RunCell> &glyphs, int cells,
+                            const SDL_Color &fg, int top, int left) {
+  if (const Layout *pieces = layout(font, text, glyphs, cells)) {
+    draw_text(font, text, fg, top, left, pieces);
+    return;
+  }
+
+  // Without the shaper's clusters, each glyph is drawn on its own.
+  for (size_t i = 0; i < glyphs.size(); i++) {
+    size_t end = i + 1 < glyphs.size() ? glyphs[i + 1].offset : text.size();
+    draw_character(font, text.substr(glyphs[i].offset, end - glyphs[i].offset),
+                   fg, top, left + glyphs[i].col * cell_width);
+  }
+}
 
-    // Copy to cache
-    SDL_SetRenderTarget(ren, cacheTex);
+const TextRenderer::Layout *
+TextRenderer::layout(TTF_Font *font, std::string_view text,
+                     const std::vector<RunCell> &glyphs, int cells) {
+  const int index = font_index(font);
+  layout_key.assign(1, static_cast<char>(index));
+  layout_key.append(text);
+
+  auto found = layouts.find(layout_key);
+  if (found == layouts.end()) {
+    // Shaped once per font and text, as the run is rasterized.
+    Layout pieces;
+    int origin = 0;
+    if (shaper && shaper->shape(index, text, shaped, origin)) {
+      pieces = layout_run(shaped, origin, glyphs, cells);
+    }
+    found = layouts.emplace(layout_key, std::move(pieces)).first;
+  }
+  return found->second.empty() ? nullptr : &found->second;
+}
 
-    // newly rendered glyph might be slightly different size.
-    // use the size from the actual rendered glyph.
-    // use the position from the cache destination
-    cached_cell_rect.w = cell_rect.w;
-    cached_cell_rect.h = cell_rect.h;
+void TextRenderer::draw_text(TTF_Font *font, std::string_view text,
+                             const SDL_Color &fg, int top, int left,
+                             const Layout *pieces) {
+  if (const GlyphCache::Entry *entry = cache.find(font, text)) {
+    ++cache_hits;
+    draw_glyph(*entry, fg, top, left, pieces);
+    return;
+  }
 
-    cell_rect.x = 0;
-    cell_rect.y = 0;
+  ++cache_misses;
 
-    SDL_RenderCopy(ren, cellTex, &cell_rect, &cached_cell_rect);
-    SDL_RenderFlush(ren);
+#ifdef DEBUG_CACHE
+  std::cout << "CACHE: Miss " << std::quoted(text) << std::endl;
+#endif
 
-    // Restore prvious render target
-    SDL_SetRenderTarget(ren, prevTexTarget);
+  // Rasterizing the run as one string lets the font shape it.
+  const GlyphCache::Entry *job = job_index.find(font, text);
+  if (job == nullptr) {
+    int index = static_cast<int>(jobs.size());
+    jobs.push_back(Rasterizer::Job{font_index(font), std::string{text}});
+    job = job_index.insert(font, text, GlyphCache::Entry{index, {}});
   }
+  misses.push_back(
+      Miss{static_cast<size_t>(job->page), fg, top, left, pieces});
+}
 
-  SDL_FreeSurface(cellSurf);
-  SDL_DestroyTexture(cellTex);
+void TextRenderer::draw_glyph(const GlyphCache::Entry &entry,
+                              const SDL_Color &fg, int top, int left,
+                              const Layout *pieces) {
+  // mark the page as recently used
+  Page &page = pages[entry.page];
+  page.referenced = true;
+
+  // The glyph's coverage, in the foreground colour, at its full size.
+  if (pieces == nullptr) {
+    SDL_Rect src_rect{entry.rect.x, entry.rect.y, entry.rect.w, entry.rect.h};
+    SDL_Rect glyph_rect{left, top, entry.rect.w, entry.rect.h};
+    page.glyphs.copy(src_rect, glyph_rect, fg, page_size, page_size);
+    return;
+  }
+
+  // A run, each piece over its own cells and cut to them.
+  for (const RunPiece &piece : *pieces) {
+    int w = std::min({piece.src_w, piece.cells * cell_width,
+                      entry.rect.w - piece.src_x});
+    if (w <= 0) {
+      continue;
+    }
+    SDL_Rect src_rect{entry.rect.x + piece.src_x, entry.rect.y, w,
+                      entry.rect.h};
+    SDL_Rect glyph_rect{left + piece.col * cell_width, top, w, entry.rect.h};
+    page.glyphs.copy(src_rect, glyph_rect, fg, page_size, page_size);
+  }
 }
 
-std::pair<int, bool> TextRenderer::get_cache_location(TTF_Font *font, std::string_view glyph,
-                                     SDL_Color fg, SDL_Color bg) {
-  auto map_key = std::make_tuple(font, fg, bg, std::string(glyph));
-  auto map_it = lru_map.find(map_key);
-  if (map_it != lru_map.end()) {
+void TextRenderer::draw_background(const SDL_Rect &rect,
+                                   const SDL_Color &colour) {
+  backgrounds.fill(rect, colour);
+}
 
-    // Cache hit
-    ++cache_hits;
+void TextRenderer::draw_rect(const SDL_Rect &rect, const SDL_Color &colour) {
+  overlays.fill(rect, colour);
+}
 
-    auto list_it = map_it->second;
-    auto list_item = *list_it;
+void TextRenderer::flush(SDL_Renderer *ren) {
+  resolve_misses(ren);
+  submit(ren);
 
-#ifdef DEBUG_CACHE
-    if (!glyph.empty() && !std::iswspace(glyph.front())) {
-      std::cout << "CACHE: Hit " << std::quoted(glyph) << " @ "
-                << list_item.second << std::endl;
+  // Nothing queued refers to a layout now, so they can go.
+  if (layouts.size() > layout_limit) {
+    layouts.clear();
+  }
+}
+
+void TextRenderer::resolve_misses(SDL_Renderer *ren) {
+  for (const BoxMiss &miss : box_misses) {
+    char utf8[4];
+    std::string_view text{utf8, unicode::encode_utf8(miss.cp, utf8)};
+
+    const GlyphCache::Entry *entry = cache.find(&box_key, text);
+    if (entry == nullptr &&
+        draw_box(miss.cp, cell_width, cell_height, box_coverage)) {
+      if (auto stored = store_coverage(ren, cell_width, cell_height,
+                                       box_coverage.data())) {
+        entry = cache.insert(&box_key, text, *stored);
+      }
     }
-#endif
+    if (entry != nullptr) {
+      draw_glyph(*entry, miss.at.fg, miss.at.top, miss.at.left);
+    }
+  }
+  box_misses.clear();
 
-    // mark entry as recently used
-    lru_list.erase(list_it);
-    lru_list.push_front(list_item);
-    lru_map[map_key] = lru_list.begin();
+  if (jobs.empty()) {
+    return;
+  }
+
+  const Rasterizer::Fonts main_fonts = fonts();
+  rasterizer->run(jobs, main_fonts);
+
+  // Each glyph's cells are queued as soon as it's stored, so they're drawn
+  // before a later glyph can evict its page.
+  std::stable_sort(misses.begin(), misses.end(),
+                   [](const Miss &l, const Miss &r) { return l.job < r.job; });
+
+  auto miss = misses.begin();
+  for (size_t i = 0; i < jobs.size(); i++) {
+    GlyphCache::Entry entry;
+    bool stored = jobs[i].surface != nullptr &&
+                  store(ren, jobs[i].surface, entry);
+
+    if (stored) {
+      cache.insert(main_fonts[jobs[i].font], jobs[i].text, entry);
+    }
 
-    return {list_item.second, true};
+    for (; miss != misses.end() && miss->job == i; ++miss) {
+      if (stored) {
+        draw_glyph(entry, miss->fg, miss->top, miss->left, miss->pieces);
+      }
+    }
   }
 
-  ++cache_misses;
+  jobs.clear();
+  job_index.clear();
+  misses.clear();
+  box_misses.clear();
+}
 
-  // Evict oldest member of cache
-  auto oldest_index = lru_list.back().second;
-  auto oldest_key = lru_list.back().first;
-  lru_list.pop_back();
-  lru_map.erase(oldest_key);
+void TextRenderer::submit(SDL_Renderer *ren) {
+  upload();
 
-#ifdef DEBUG_CACHE
-  std::cout << "CACHE: Miss " << std::quoted(glyph) << " + " << oldest_index
-            << std::endl;
-#endif
+  backgrounds.submit(ren, nullptr);
+  for (auto &page : pages) {
+    page.glyphs.submit(ren, page.tex);
+  }
+  overlays.submit(ren, nullptr);
+}
+
+std::optional<GlyphCache::Entry> TextRenderer::allocate(SDL_Renderer *ren,
+                                                        int w, int h) {
+  auto place = [&](int page) -> std::optional<GlyphCache::Entry> {
+    if (auto rect = pages[page].packer.allocate(w, h)) {
+      return GlyphCache::Entry{page, *rect};
+    }
+    return {};
+  };
 
-  // Emplace new item in cache using newly freed index
-  lru_list.push_front(std::make_pair(map_key, oldest_index));
-  lru_map[map_key] = lru_list.begin();
+  // Any page with room, the newest are the ones being filled.
+  for (int i = static_cast<int>(pages.size()) - 1; i >= 0; i--) {
+    if (auto entry = place(i)) {
+      return entry;
+    }
+  }
 
-  return {oldest_index, false};
+  // A new page, while within the budget.
+  const size_t page_bytes = size_t{4} * page_size * page_size;
+
+  if (pages.empty() || (pages.size() + 1) * page_bytes <= atlas_budget) {
+    SDL_Texture *tex =
+        SDL_CreateTexture(ren, SDL_PIXELFORMAT_ARGB8888,
+                          SDL_TEXTUREACCESS_STATIC, page_size, page_size);
+    if (tex != nullptr) {
+      // Glyphs are blended over the background, tinted by the vertex colour.
+      SDL_SetTextureBlendMode(tex, SDL_BLENDMODE_BLEND);
+      pages.push_back(Page{tex, ShelfPacker{page_size, page_size}, false, {},
+                           std::vector<uint32_t>(size_t{1} * page_size *
+                                                 page_size),
+                           {}});
+      return place(static_cast<int>(pages.size()) - 1);
+    }
+
+    std::cerr << "Unable to add a glyph cache page: " << SDL_GetError()
+              << std::endl;
+  }
+
+  if (pages.empty()) {
+    return {};
+  }
+
+  // Otherwise sweep the clock hand round to a page not used since it last
+  // passed, empty it, and start again on it.
+  while (pages[clock_hand].referenced) {
+    pages[clock_hand].referenced = false;
+    clock_hand = (clock_hand + 1) % pages.size();
+  }
+  int page = static_cast<int>(clock_hand);
+  clock_hand = (clock_hand + 1) % pages.size();
+
+  evict(ren, page);
+  return place(page);
 }
 
-void TextRenderer::dump_cache_stats() {
-  std::cout << "Cell cache stats: hits:" << cache_hits
-            << " misses:" << cache_misses << "\n";
-  std::cout << "Cell cache stats: efficiency:" << std::setprecision(2)
-            << static_cast<float>(cache_hits) / (cache_misses + cache_hits)
-            << "\n";
+void TextRenderer::evict(SDL_Renderer *ren, int page) {
+  ++page_evictions;
 
-  cache_hits = cache_misses = 0;
+  // Glyphs queued from the page must be drawn before it's overwritten, over
+  // the backgrounds queued so far. Other pages and the overlays wait for the
+  // end of the frame, so nothing queued later is drawn under them.
+  if (!pages[page].glyphs.empty()) {
+    upload();
+    backgrounds.submit(ren, nullptr);
+    pages[page].glyphs.submit(ren, pages[page].tex);
+  }
+
+  cache.erase_page(page);
+  pages[page].packer.clear();
+}
+
+void TextRenderer::clear_pages() {
+  for (auto &page : pages) {
+    SDL_DestroyTexture(page.tex);
+  }
+  pages.clear();
+  clock_hand = 0;
+  cache.clear();
+
+  jobs.clear();
+  job_index.clear();
+  misses.clear();
+  box_misses.clear();
+}
+
+bool TextRenderer::store(SDL_Renderer *ren, SDL_Surface *cellSurf,
+                         GlyphCache::Entry &entry) {
+  // Wide glyphs take the space they need.
+  auto place = allocate(ren, cellSurf->w, cellSurf->h);
+  if (!place) {
+    SDL_FreeSurface(cellSurf);
+    return false;
+  }
+  entry = *place;
+
+  // Copy into the page's pixels, to be uploaded when the frame is drawn.
+  Page &page = pages[entry.page];
+  const AtlasRect &rect = entry.rect;
+
+  if (SDL_MUSTLOCK(cellSurf)) {
+    SDL_LockSurface(cellSurf);
+  }
+  for (int y = 0; y < rect.h; y++) {
+    const auto *src = reinterpret_cast<const uint32_t *>(
+        static_cast<const char *>(cellSurf->pixels) + y * cellSurf->pitch);
+    std::copy(src, src + rect.w,
+              page.pixels.begin() + (rect.y + y) * page_size + rect.x);
+  }
+  if (SDL_MUSTLOCK(cellSurf)) {
+    SDL_UnlockSurface(cellSurf);
+  }
+  SDL_FreeSurface(cellSurf);
+
+  mark_dirty(page, rect);
+  disk_cache_stale = true;
+  return true;
+}
+
+void TextRenderer::mark_dirty(Page &page, const AtlasRect &rect) {
+  // Grow the page's dirty area to cover the rectangle.
+  AtlasRect &dirty = page.dirty;
+  if (dirty.w == 0) {
+    dirty = rect;
+  } else {
+    int right = std::max(dirty.x + dirty.w, rect.x + rect.w);
+    int bottom = std::max(dirty.y + dirty.h, rect.y + rect.h);
+    dirty.x = std::min(dirty.x, rect.x);
+    dirty.y = std::min(dirty.y, rect.y);
+    dirty.w = right - dirty.x;
+    dirty.h = bottom - dirty.y;
+  }
+}
+
+std::optional<GlyphCache::Entry>
+TextRenderer::store_coverage(SDL_Renderer *ren, int w, int h,
+                             const uint8_t *alpha) {
+  auto entry = allocate(ren, w, h);
+  if (!entry) {
+    return {};
+  }
+
+  // As white on transparent, like rasterized glyphs.
+  Page &page = pages[entry->page];
+  const AtlasRect &rect = entry->rect;
+  for (int y = 0; y < rect.h; y++) {
+    uint32_t *row = page.pixels.data() + (rect.y + y) * page_size + rect.x;
+    for (int x = 0; x < rect.w; x++) {
+      row[x] = uint32_t{alpha[y * rect.w + x]} << 24 | 0xFFFFFF;
+    }
+  }
+  mark_dirty(page, rect);
+
+  return entry;
+}
+
+bool TextRenderer::prewarm(SDL_Renderer *ren) {
+  // Printable ASCII in each of the four styles, a batch at a time. Spaces
+  // are never drawn.
+  constexpr int first = 0x21;
+  constexpr int per_style = 0x7E - first + 1;
+  constexpr int total = 4 * per_style;
+  constexpr size_t batch_size = 64;
+
+  if (!rasterizer || prewarm_next >= total) {
+    return false;
+  }
+
+  const Rasterizer::Fonts all = fonts();
+
+  std::vector<Rasterizer::Job> batch;
+  for (; prewarm_next < total && batch.size() < batch_size; prewarm_next++) {
+    int font = prewarm_next / per_style;
+    std::string text(1, static_cast<char>(first + prewarm_next % per_style));
+    if (cache.find(all[font], text) == nullptr) {
+      batch.push_back(Rasterizer::Job{font, std::move(text)});
+    }
+  }
+
+  rasterizer->run(batch, all);
+
+  for (auto &job : batch) {
+    GlyphCache::Entry entry;
+    if (job.surface != nullptr && store(ren, job.surface, entry)) {
+      cache.insert(all[job.font], job.text, entry);
+    }
+  }
+
+  return prewarm_next < total;
+}
+
+void TextRenderer::load_disk_cache(SDL_Renderer *ren) {
+  io::MappedFile file{disk_cache_path};
+  if (!file) {
+    return;
+  }
+
+  const char *pos = file.data();
+  const char *end = file.data() + file.size();
+  auto read = [&](void *out, size_t size) {
+    if (static_cast<size_t>(end - pos) < size) {
+      return false;
+    }
+    memcpy(out, pos, size);
+    pos += size;
+    return true;
+  };
+
+  DiskHeader header;
+  if (!read(&header, sizeof(header)) ||
+      memcmp(header.magic, disk_magic, sizeof(disk_magic)) != 0 ||
+      header.key != disk_cache_key) {
+    return;
+  }
+
+  const Rasterizer::Fonts all = fonts();
+  size_t loaded = 0;
+
+  for (uint32_t i = 0; i < header.count; i++) {
+    DiskGlyph glyph;
+    if (!read(&glyph, sizeof(glyph)) || glyph.font > 3) {
+      break;
+    }
+
+    const size_t pixels = size_t{glyph.w} * glyph.h;
+    if (static_cast<size_t>(end - pos) < glyph.length + pixels) {
+      break;
+    }
+    std::string_view text{pos, glyph.length};
+    const auto *alpha = reinterpret_cast<const unsigned char *>(pos) +
+                        glyph.length;
+    pos += glyph.length + pixels;
+
+    if (cache.find(all[glyph.font], text) != nullptr) {
+      continue;
+    }
+
+    auto entry = store_coverage(ren, glyph.w, glyph.h, alpha);
+    if (!entry) {
+      break;
+    }
+
+    cache.insert(all[glyph.font], text, *entry);
+    loaded++;
+  }
+
+  std::cout << "Loaded " << loaded << " glyphs from " << disk_cache_path
+            << "\n";
 }
 
-size_t cell_cache_key_hash::operator()(const CellCacheKey &p) const {
-  auto pointer_hash = std::hash<void *>{}(std::get<0>(p));
+void TextRenderer::save_disk_cache() {
+  if (!disk_cache_stale || disk_cache_path.empty()) {
+    return;
+  }
+  disk_cache_stale = false;
+
+  // Written aside and renamed into place, so another terminal starting up
+  // never reads half a file.
+  const std::string temp_path =
+      disk_cache_path + "." +
+      std::to_string(
+          std::chrono::steady_clock::now().time_since_epoch().count()) +
+      ".tmp";
+
+  std::ofstream out{temp_path, std::ios::binary};
+
+  DiskHeader header{};
+  memcpy(header.magic, disk_magic, sizeof(disk_magic));
+  header.key = disk_cache_key;
+  out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+  const Rasterizer::Fonts all = fonts();
+  std::vector<char> alpha;
+
+  cache.for_each([&](const void *font, std::string_view text,
+                     const GlyphCache::Entry &entry) {
+    int index = font_index(font);
+    if (all[index] != font || text.size() > 0xFF) {
+      return;
+    }
 
-  auto color1_hash = std::hash<uint32_t>{}(
-      *reinterpret_cast<const uint32_t *>(&std::get<1>(p)));
-  auto color2_hash = std::hash<uint32_t>{}(
-      *reinterpret_cast<const uint32_t *>(&std::get<2>(p)));
+    const AtlasRect &rect = entry.rect;
+    DiskGlyph glyph{static_cast<uint8_t>(index),
+                    static_cast<uint8_t>(text.size()),
+                    static_cast<uint16_t>(rect.w),
+                    static_cast<uint16_t>(rect.h)};
+
+    alpha.clear();
+    for (int y = 0; y < rect.h; y++) {
+      const uint32_t *row =
+          pages[entry.page].pixels.data() + (rect.y + y) * page_size + rect.x;
+      for (int x = 0; x < rect.w; x++) {
+        alpha.push_back(static_cast<char>(row[x] >> 24));
+      }
+    }
 
-  auto string_hash = std::hash<std::string>{}(std::get<3>(p));
+    out.write(reinterpret_cast<const char *>(&glyph), sizeof(glyph));
+    out.write(text.data(), static_cast<std::streamsize>(text.size()));
+    out.write(alpha.data(), static_cast<std::streamsize>(alpha.size()));
+    header.count++;
+  });
 
-  return string_hash ^ pointer_hash ^ color1_hash ^ color2_hash;
+  out.seekp(0);
+  out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  out.close();
+
+  std::error_code ec;
+  if (out) {
+    std::filesystem::rename(temp_path, disk_cache_path, ec);
+  }
+  if (!out || ec) {
+    std::filesystem::remove(temp_path, ec);
+    return;
+  }
+
+  std::cout << "Saved " << header.count << " glyphs to " << disk_cache_path
+            << "\n";
 }
 
-void save_texture(std::string_view file_name, SDL_Renderer *renderer,
-                  SDL_Texture *texture) {
-  SDL_Texture *target = SDL_GetRenderTarget(renderer);
-  SDL_SetRenderTarget(renderer, texture);
-  int width, height;
-  SDL_QueryTexture(texture, NULL, NULL, &width, &height);
-  SDL_Surface *surface = SDL_CreateRGBSurface(0, width, height, 32, 0, 0, 0, 0);
-  SDL_RenderReadPixels(renderer, NULL, surface->format->format, surface->pixels,
-                       surface->pitch);
-  SDL_SaveBMP(surface, file_name.data());
-  SDL_FreeSurface(surface);
-  SDL_SetRenderTarget(renderer, target);
+void TextRenderer::upload() {
+  for (auto &page : pages) {
+    AtlasRect &dirty = page.dirty;
+    if (dirty.w == 0) {
+      continue;
+    }
+
+    SDL_Rect rect{dirty.x, dirty.y, dirty.w, dirty.h};
+    SDL_UpdateTexture(page.tex, &rect,
+                      page.pixels.data() + dirty.y * page_size + dirty.x,
+                      page_size * 4);
+    dirty = AtlasRect{};
+  }
 }
 
-void TextRenderer::dump_cache_to_disk(SDL_Renderer *ren) const {
+void TextRenderer::dump_cache_stats() {
+  std::cout << "Cell cache stats: hits:" << cache_hits
+            << " misses:" << cache_misses << " pages:" << pages.size()
+            << " page evictions:" << page_evictions << "\n";
+  // Nothing drawn since the last dump, so no efficiency to speak of.
+  if (cache_hits + cache_misses != 0) {
+    std::cout << "Cell cache stats: efficiency:" << std::setprecision(2)
+              << static_cast<float>(cache_hits) / (cache_misses + cache_hits)
+              << "\n";
+  }
+
+  cache_hits = cache_misses = 0;
+}
+
+void TextRenderer::dump_cache_to_disk() const {
   static int idx = 0;
   idx++;
 
-  save_texture("cell_cache_" + std::to_string(idx), ren, cacheTex);
+  for (size_t i = 0; i < pages.size(); i++) {
+    SDL_Surface *surface = SDL_CreateRGBSurfaceWithFormat(
+        0, page_size, page_size, 32, SDL_PIXELFORMAT_ARGB8888);
+    if (surface == nullptr) {
+      continue;
+    }
+
+    for (int y = 0; y < page_size; y++) {
+      const uint32_t *row = pages[i].pixels.data() + y * page_size;
+      std::copy(row, row + page_size,
+                reinterpret_cast<uint32_t *>(
+                    static_cast<char *>(surface->pixels) + y * surface->pitch));
+    }
+
+    std::string file_name =
+        "cell_cache_" + std::to_string(idx) + "_" + std::to_string(i);
+    SDL_SaveBMP(surface, file_name.c_str());
+    SDL_FreeSurface(surface);
+  }
 }
 
 } // namespace gfx
\ No newline at end of file
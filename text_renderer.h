@@ -1,10 +1,19 @@
 #pragma once
 #include <SDL.h>
 #include <SDL_ttf.h>
-#include <list>
+#include <memory>
+#include <optional>
 #include <string>
 #include <string_view>
 #include <unordered_map>
+#include <vector>
+
+#include "atlas.hpp"
+#include "geometry.hpp"
+#include "glyph_cache.hpp"
+#include "rasterizer.hpp"
+#include "run_layout.hpp"
+#include "shaper.hpp"
 
 namespace gfx {
 
@@ -17,54 +26,155 @@ public:
   int pointsize;
 };
 
-using CellCacheKey = std::tuple<TTF_Font *, SDL_Color, SDL_Color, std::string>;
-
-struct cell_cache_key_hash {
-  size_t operator()(CellCacheKey const &p) const;
-};
-
-using CacheList = std::list<std::pair<CellCacheKey, int>>;
-using CacheMap =
-    std::unordered_map<CellCacheKey, CacheList::iterator, cell_cache_key_hash>;
-
 class TextRenderer {
   TTF_Font *fontRegular = nullptr;
   TTF_Font *fontRegularItalic = nullptr;
   TTF_Font *fontBold = nullptr;
   TTF_Font *fontBoldItalic = nullptr;
 
-  // Cell cache
-  static constexpr int cache_width_cells = 48;  // cache size in cells
-  static constexpr int cache_height_cells = 48; // cache size in cells
-  SDL_Texture *cacheTex = nullptr;
+  // Glyph cache, white glyphs on transparent, tinted when drawn. Glyphs are
+  // cached as coverage only, so one entry serves every colour, and shelf
+  // packed at their rendered size into pages, which are added as needed up
+  // to the budget. When full, a page not used since the clock hand last
+  // passed it is emptied for reuse. Glyphs are rasterized into a copy of
+  // each page in memory, and the new pixels uploaded once a frame. Shaped
+  // runs are cached the same way, under their whole text.
+  struct Page {
+    SDL_Texture *tex = nullptr;
+    ShelfPacker packer;
+    bool referenced = false;
+    QuadBatch glyphs; // queued to draw this frame
+    std::vector<uint32_t> pixels; // ARGB, the texture's contents
+    AtlasRect dirty;              // pixels not yet uploaded
+  };
+  std::vector<Page> pages;
+  int page_size = 1024; // pixels square
+  size_t clock_hand = 0;
 
   int cache_hits = 0;
   int cache_misses = 0;
+  int page_evictions = 0;
+
+  GlyphCache cache;
 
-  CacheList lru_list;
-  CacheMap lru_map;
+  // The frame is queued and drawn in layers: backgrounds, glyphs, then
+  // rectangles over the glyphs.
+  QuadBatch backgrounds;
+  QuadBatch overlays;
+
+  // Where each cluster of a shaped run goes, by font and text. Looked up as
+  // runs are drawn, shaped again only when a run's text is new.
+  using Layout = std::vector<RunPiece>;
+  std::unique_ptr<Shaper> shaper;
+  std::unordered_map<std::string, Layout> layouts;
+  std::string layout_key;
+  std::vector<ShapedGlyph> shaped;
+  static constexpr size_t layout_limit = 1 << 14;
+
+  // Glyphs missed this frame, rasterized together when it's flushed. Each is
+  // rasterized once however many cells show it.
+  struct Miss {
+    size_t job;
+    SDL_Color fg;
+    int top;
+    int left;
+    const Layout *pieces; // of a run, nullptr for a glyph drawn whole
+  };
+  std::unique_ptr<Rasterizer> rasterizer;
+  std::vector<Rasterizer::Job> jobs;
+  GlyphCache job_index; // the job of each glyph, as its page
+  std::vector<Miss> misses;
+
+  // Box drawing missed this frame, drawn procedurally. Cached under the
+  // address of box_key rather than a font.
+  struct BoxMiss {
+    uint32_t cp;
+    Miss at;
+  };
+  std::vector<BoxMiss> box_misses;
+  std::vector<uint8_t> box_coverage;
+  char box_key = 0;
+
+  // Glyphs are kept on disk between runs, in a file keyed by the fonts.
+  std::string disk_cache_path;
+  uint64_t disk_cache_key = 0;
+  bool disk_cache_stale = false; // glyphs added since it was read or written
+  int prewarm_next = 0;          // the next ASCII glyph to rasterize ahead
 
 public:
   int cell_width = 6;
   int cell_height = 12;
   int font_height = 12;
   int font_point = 14;
+  int font_ascent = 10;
+
+  // Runs are cut at this many cells, so they fit a glyph cache page.
+  static constexpr int max_run_cells = 32;
+
+  // Bytes of glyph textures, each with a copy in memory.
+  size_t atlas_budget = 64 << 20;
 
   void load_fonts(SDL_Renderer *ren, const FontSpec &);
   TTF_Font *get_font(bool bold = false, bool italic = false) const;
   std::pair<int, int> cell_size() const;
-  void draw_character(SDL_Renderer *ren, TTF_Font *font, std::string_view glyph,
-                      const SDL_Color &fg, const SDL_Color &bg, int top,
-                      int left);
+  void draw_character(TTF_Font *font, std::string_view glyph,
+                      const SDL_Color &fg, int top, int left);
+  // Queue a glyph from the cell at left, a wide glyph covering the next cell
+  // too. Its background is queued separately.
+  void draw_run(TTF_Font *font, std::string_view text,
+                const std::vector<RunCell> &glyphs, int cells,
+                const SDL_Color &fg, int top, int left);
+  // Queue a run of glyphs rasterized together, so the font can shape them
+  // into ligatures and joined forms. glyphs are where each glyph's text
+  // starts and the cell it's in; the shaped clusters are mapped back to
+  // them, so each is drawn over its own cells whatever the font's advances.
+  // Cached by font and text like a glyph, so a run is only shaped again when
+  // its text changes. Their backgrounds are queued separately.
+  void draw_background(const SDL_Rect &rect, const SDL_Color &colour);
+  // Queue a rectangle of background, under every glyph.
+  void draw_rect(const SDL_Rect &rect, const SDL_Color &colour);
+  // Queue a rectangle over the glyphs, for decorations and the cursor.
+  void flush(SDL_Renderer *ren);
+  // Draw everything queued, in a few calls.
+  bool prewarm(SDL_Renderer *ren);
+  // Rasterize a few more printable ASCII glyphs in every style, ahead of
+  // use. True while there are more to do.
   void dump_cache_stats();
-  void dump_cache_to_disk(SDL_Renderer *ren) const;
+  void dump_cache_to_disk() const;
   ~TextRenderer();
 
 private:
-  // returns the (possibley new) cache location of the item.
-  // {index_location, is_empty}
-  std::pair<int, bool> get_cache_location(TTF_Font *font,
-                                          std::string_view glyph, SDL_Color fg,
-                                          SDL_Color bg);
+  Rasterizer::Fonts fonts() const;
+  int font_index(const void *font) const;
+  // The index of font in fonts().
+  void draw_glyph(const GlyphCache::Entry &entry, const SDL_Color &fg, int top,
+                  int left, const Layout *pieces = nullptr);
+  // Queue a cached glyph, whole or as the pieces of a run.
+  void draw_text(TTF_Font *font, std::string_view text, const SDL_Color &fg,
+                 int top, int left, const Layout *pieces);
+  // Queue text rasterized as one, from the cache or when the frame's misses
+  // are resolved.
+  const Layout *layout(TTF_Font *font, std::string_view text,
+                       const std::vector<RunCell> &glyphs, int cells);
+  // The pieces of a run, shaping it if it's new. nullptr if it can't be
+  // mapped to its cells.
+  void resolve_misses(SDL_Renderer *ren);
+  // Rasterize the frame's misses, cache them, and queue their cells.
+  void submit(SDL_Renderer *ren);
+  std::optional<GlyphCache::Entry> allocate(SDL_Renderer *ren, int w, int h);
+  // Space in a page, adding or evicting one if need be.
+  void evict(SDL_Renderer *ren, int page);
+  void clear_pages();
+  bool store(SDL_Renderer *ren, SDL_Surface *surface,
+             GlyphCache::Entry &entry);
+  // Copy a rasterized glyph into a new place in the cache, and free it.
+  void mark_dirty(Page &page, const AtlasRect &rect);
+  std::optional<GlyphCache::Entry> store_coverage(SDL_Renderer *ren, int w,
+                                                  int h, const uint8_t *alpha);
+  // Copy a coverage mask into a new place in the cache.
+  void load_disk_cache(SDL_Renderer *ren);
+  void save_disk_cache();
+  void upload();
+  // Copy the pixels added to each page since the last frame to its texture.
 };
 } // namespace gfx
\ No newline at end of file
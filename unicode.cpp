@@ -0,0 +1,374 @@
+#include "unicode.hpp"
+
+#include <string.h>
+
+// The SSSE3 validator is built into every x86-64 build. Unless the compiler
+// may assume SSSE3 throughout, it's compiled for SSSE3 alone and chosen at
+// run time.
+#if defined(__SSSE3__) || defined(__AVX2__)
+#include <tmmintrin.h>
+#define PEACHTERM_UNICODE_SSSE3
+#define PEACHTERM_TARGET_SSSE3
+#elif defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <tmmintrin.h>
+#define PEACHTERM_UNICODE_SSSE3
+#define PEACHTERM_UNICODE_SSSE3_DISPATCH
+#define PEACHTERM_TARGET_SSSE3 __attribute__((target("ssse3")))
+#elif defined(_M_X64)
+#include <intrin.h>
+#include <tmmintrin.h>
+#define PEACHTERM_UNICODE_SSSE3
+#define PEACHTERM_UNICODE_SSSE3_DISPATCH
+#define PEACHTERM_TARGET_SSSE3
+#endif
+
+namespace unicode {
+
+namespace {
+
+constexpr char replacement_utf8[] = "\xEF\xBF\xBD";
+
+bool decoded_invalid(const char *start, const char *pos, uint32_t cp) {
+  // A valid encoding of U+FFFD decodes the same as an invalid sequence.
+  return cp == 0xFFFD &&
+         (pos - start != 3 || memcmp(start, replacement_utf8, 3) != 0);
+}
+
+#if defined(PEACHTERM_UNICODE_SSSE3)
+// UTF-8 validation by table lookup, after Keiser and Lemire, "Validating
+// UTF-8 In Less Than One Instruction Per Byte". Each pair of adjacent bytes
+// is classified by three 16 entry tables, indexed by the high and low nibble
+// of the first byte and the high nibble of the second. Each table entry is a
+// set of the errors that nibble is consistent with, so an error is present
+// where all three agree. Sequences of three and four bytes are completed by
+// checking continuation bytes two and three bytes after a lead.
+class Utf8Checker {
+  static constexpr uint8_t TOO_SHORT = 1 << 0;  // lead, then not continuation
+  static constexpr uint8_t TOO_LONG = 1 << 1;   // ascii, then continuation
+  static constexpr uint8_t OVERLONG_3 = 1 << 2; // E0 80..9F
+  static constexpr uint8_t TOO_LARGE = 1 << 3;  // F4 90..BF, F5..FF
+  static constexpr uint8_t SURROGATE = 1 << 4;  // ED A0..BF
+  static constexpr uint8_t OVERLONG_2 = 1 << 5; // C0, C1
+  static constexpr uint8_t TOO_LARGE_1000 = 1 << 6;
+  static constexpr uint8_t OVERLONG_4 = 1 << 6; // F0 80..8F
+  static constexpr uint8_t TWO_CONTS = 1 << 7;  // continuation, continuation
+  static constexpr uint8_t CARRY = TOO_SHORT | TOO_LONG | TWO_CONTS;
+
+  __m128i error = _mm_setzero_si128();
+  __m128i previous = _mm_setzero_si128();
+
+  PEACHTERM_TARGET_SSSE3 static __m128i high_nibbles(__m128i v) {
+    return _mm_and_si128(_mm_srli_epi16(v, 4), _mm_set1_epi8(0x0F));
+  }
+
+  PEACHTERM_TARGET_SSSE3 static __m128i lookup(__m128i index,
+                                               __m128i table) {
+    return _mm_shuffle_epi8(table, index);
+  }
+
+public:
+  PEACHTERM_TARGET_SSSE3 void check(__m128i input) {
+    // clang-format off
+    const __m128i byte_1_high = _mm_setr_epi8(
+        TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+        TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+        TWO_CONTS, TWO_CONTS, TWO_CONTS, TWO_CONTS,
+        TOO_SHORT | OVERLONG_2,
+        TOO_SHORT,
+        TOO_SHORT | OVERLONG_3 | SURROGATE,
+        TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4);
+
+    const __m128i byte_1_low = _mm_setr_epi8(
+        CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4,
+        CARRY | OVERLONG_2,
+        CARRY,
+        CARRY,
+        CARRY | TOO_LARGE,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000 | SURROGATE,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000);
+
+    const __m128i byte_2_high = _mm_setr_epi8(
+        TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+        TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+        static_cast<char>(TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 |
+                          TOO_LARGE_1000 | OVERLONG_4),
+        static_cast<char>(TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 |
+                          TOO_LARGE),
+        static_cast<char>(TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE |
+                          TOO_LARGE),
+        static_cast<char>(TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE |
+                          TOO_LARGE),
+        TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT);
+    // clang-format on
+
+    // The input shifted along by one, two and three bytes, continuing from
+    // the previous block.
+    __m128i prev1 = _mm_alignr_epi8(input, previous, 15);
+    __m128i prev2 = _mm_alignr_epi8(input, previous, 14);
+    __m128i prev3 = _mm_alignr_epi8(input, previous, 13);
+
+    __m128i special = _mm_and_si128(
+        _mm_and_si128(lookup(high_nibbles(prev1), byte_1_high),
+                      lookup(_mm_and_si128(prev1, _mm_set1_epi8(0x0F)),
+                             byte_1_low)),
+        lookup(high_nibbles(input), byte_2_high));
+
+    // Only bytes two after E0..FF, or three after F0..FF, reach 0x80 here.
+    __m128i third = _mm_subs_epu8(prev2, _mm_set1_epi8(0xE0 - 0x80));
+    __m128i fourth = _mm_subs_epu8(prev3, _mm_set1_epi8(0xF0 - 0x80));
+    __m128i must_continue = _mm_and_si128(_mm_or_si128(third, fourth),
+                                          _mm_set1_epi8(static_cast<char>(0x80)));
+
+    error = _mm_or_si128(error, _mm_xor_si128(must_continue, special));
+    previous = input;
+  }
+
+  PEACHTERM_TARGET_SSSE3 bool valid() const {
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(error, _mm_setzero_si128())) ==
+           0xFFFF;
+  }
+};
+#endif
+
+} // namespace
+
+uint32_t decode_utf8(const char *&pos, const char *end) {
+  constexpr uint32_t replacement = 0xFFFD;
+
+  auto byte = [](const char *p) { return static_cast<unsigned char>(*p); };
+
+  uint32_t c = byte(pos++);
+
+  if (c < 0x80) {
+    return c;
+  }
+
+  int trailing;
+  // The range allowed for the first continuation byte excludes overlong
+  // forms, surrogates and values past U+10FFFF.
+  unsigned char lo = 0x80, hi = 0xBF;
+
+  if (c < 0xC2) {
+    return replacement;
+  } else if (c < 0xE0) {
+    trailing = 1;
+    c &= 0x1F;
+  } else if (c < 0xF0) {
+    trailing = 2;
+    lo = c == 0xE0 ? 0xA0 : 0x80;
+    hi = c == 0xED ? 0x9F : 0xBF;
+    c &= 0x0F;
+  } else if (c < 0xF5) {
+    trailing = 3;
+    lo = c == 0xF0 ? 0x90 : 0x80;
+    hi = c == 0xF4 ? 0x8F : 0xBF;
+    c &= 0x07;
+  } else {
+    return replacement;
+  }
+
+  for (int i = 0; i < trailing; i++) {
+    if (pos == end || byte(pos) < lo || byte(pos) > hi) {
+      return replacement;
+    }
+    c = (c << 6) | (byte(pos++) & 0x3F);
+    lo = 0x80;
+    hi = 0xBF;
+  }
+
+  return c;
+}
+
+size_t encode_utf8(uint32_t cp, char *out) {
+  auto byte = [](uint32_t b) { return static_cast<char>(b); };
+
+  if (cp < 0x80) {
+    out[0] = byte(cp);
+    return 1;
+  } else if (cp < 0x800) {
+    out[0] = byte(0xC0 | (cp >> 6));
+    out[1] = byte(0x80 | (cp & 0x3F));
+    return 2;
+  } else if (cp < 0x10000) {
+    out[0] = byte(0xE0 | (cp >> 12));
+    out[1] = byte(0x80 | ((cp >> 6) & 0x3F));
+    out[2] = byte(0x80 | (cp & 0x3F));
+    return 3;
+  }
+
+  out[0] = byte(0xF0 | (cp >> 18));
+  out[1] = byte(0x80 | ((cp >> 12) & 0x3F));
+  out[2] = byte(0x80 | ((cp >> 6) & 0x3F));
+  out[3] = byte(0x80 | (cp & 0x3F));
+  return 4;
+}
+
+bool is_valid_utf8(const char *data, size_t length) {
+#if defined(PEACHTERM_UNICODE_SSSE3_DISPATCH)
+  static const bool ssse3 = detail::has_ssse3();
+  return ssse3 ? detail::is_valid_utf8_ssse3(data, length)
+               : detail::is_valid_utf8_scalar(data, length);
+#elif defined(PEACHTERM_UNICODE_SSSE3)
+  return detail::is_valid_utf8_ssse3(data, length);
+#else
+  return detail::is_valid_utf8_scalar(data, length);
+#endif
+}
+
+namespace detail {
+
+bool has_ssse3() {
+#if defined(PEACHTERM_UNICODE_SSSE3_DISPATCH) && defined(_MSC_VER)
+  int info[4];
+  __cpuid(info, 1);
+  return (info[2] & (1 << 9)) != 0;
+#elif defined(PEACHTERM_UNICODE_SSSE3_DISPATCH)
+  return __builtin_cpu_supports("ssse3");
+#elif defined(PEACHTERM_UNICODE_SSSE3)
+  return true;
+#else
+  return false;
+#endif
+}
+
+bool is_valid_utf8_scalar(const char *data, size_t length) {
+  const char *pos = data;
+  const char *end = data + length;
+
+  while (pos != end) {
+    if (static_cast<unsigned char>(*pos) < 0x80) {
+      pos++;
+      continue;
+    }
+
+    const char *start = pos;
+    uint32_t cp = decode_utf8(pos, end);
+    if (decoded_invalid(start, pos, cp)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+#if defined(PEACHTERM_UNICODE_SSSE3)
+PEACHTERM_TARGET_SSSE3 bool is_valid_utf8_ssse3(const char *data,
+                                                size_t length) {
+  Utf8Checker checker;
+
+  size_t pos = 0;
+  for (; pos + 16 <= length; pos += 16) {
+    checker.check(
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + pos)));
+  }
+
+  // The last block is padded with NULs, which also catch a sequence left
+  // incomplete at the very end.
+  alignas(16) char last[16] = {};
+  memcpy(last, data + pos, length - pos);
+  checker.check(_mm_load_si128(reinterpret_cast<const __m128i *>(last)));
+
+  return checker.valid();
+}
+#else
+bool is_valid_utf8_ssse3(const char *data, size_t length) {
+  return is_valid_utf8_scalar(data, length);
+}
+#endif
+
+} // namespace detail
+
+void replace_invalid_utf8(const char *data, size_t length, std::string &out) {
+  const char *pos = data;
+  const char *end = data + length;
+
+  while (pos != end) {
+    const char *start = pos;
+    uint32_t cp = decode_utf8(pos, end);
+    if (decoded_invalid(start, pos, cp)) {
+      out.append(replacement_utf8);
+    } else {
+      out.append(start, pos);
+    }
+  }
+}
+
+bool GraphemeBreaker::breaks_before(Properties p) {
+  using GB = GraphemeBreak;
+
+  const GB cur = p.grapheme_break();
+
+  auto is_control = [](GB b) {
+    return b == GB::CONTROL || b == GB::CR || b == GB::LF;
+  };
+
+  bool result;
+
+  // clang-format off
+  if (start)                                           result = true;  // GB1
+  else if (prev == GB::CR && cur == GB::LF)            result = false; // GB3
+  else if (is_control(prev) || is_control(cur))        result = true;  // GB4, GB5
+  else if (prev == GB::L && (cur == GB::L || cur == GB::V ||
+                             cur == GB::LV || cur == GB::LVT))
+                                                       result = false; // GB6
+  else if ((prev == GB::LV || prev == GB::V) &&
+           (cur == GB::V || cur == GB::T))             result = false; // GB7
+  else if ((prev == GB::LVT || prev == GB::T) && cur == GB::T)
+                                                       result = false; // GB8
+  else if (cur == GB::EXTEND || cur == GB::ZWJ)        result = false; // GB9
+  else if (cur == GB::SPACING_MARK)                    result = false; // GB9a
+  else if (prev == GB::PREPEND)                        result = false; // GB9b
+  else if (pictographic_zwj && p.extended_pictographic())
+                                                       result = false; // GB11
+  else if (prev == GB::REGIONAL_INDICATOR &&
+           cur == GB::REGIONAL_INDICATOR && odd_regional)
+                                                       result = false; // GB12, GB13
+  else                                                 result = true;  // GB999
+  // clang-format on
+
+  pictographic_zwj = pictographic && cur == GB::ZWJ;
+  pictographic =
+      p.extended_pictographic() || (pictographic && cur == GB::EXTEND);
+  odd_regional = cur == GB::REGIONAL_INDICATOR && !odd_regional;
+  prev = cur;
+  start = false;
+
+  return result;
+}
+
+int cluster_width(const char *cluster, size_t length) {
+  const char *pos = cluster;
+  const char *end = cluster + length;
+
+  if (pos == end) {
+    return 1;
+  }
+
+  Properties base = properties(decode_utf8(pos, end));
+
+  if (base.wide()) {
+    return 2;
+  }
+
+  if (base.extended_pictographic()) {
+    // Text style pictographs become emoji with variation selector 16.
+    while (pos != end) {
+      if (decode_utf8(pos, end) == 0xFE0F) {
+        return 2;
+      }
+    }
+  }
+
+  return 1;
+}
+
+} // namespace unicode
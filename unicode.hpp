@@ -0,0 +1,112 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+namespace unicode {
+
+// Grapheme_Cluster_Break property values, from UAX #29.
+enum class GraphemeBreak : uint8_t {
+  OTHER,
+  CR,
+  LF,
+  CONTROL,
+  EXTEND,
+  ZWJ,
+  REGIONAL_INDICATOR,
+  PREPEND,
+  SPACING_MARK,
+  L,
+  V,
+  T,
+  LV,
+  LVT
+};
+
+namespace detail {
+
+// The properties of each code point are packed into a byte, and looked up
+// through a two stage table: stage1 maps each block of 2^block_shift code
+// points to the (deduplicated) block in stage2 which holds their bytes.
+// The tables live in unicode_tables.cpp, written by unicode-gen.
+constexpr unsigned block_shift = 7;
+constexpr unsigned block_size = 1u << block_shift;
+constexpr uint32_t max_code_point = 0x10FFFF;
+
+constexpr uint8_t break_mask = 0x0F;
+constexpr uint8_t extended_pictographic = 0x10;
+constexpr uint8_t wide = 0x20;
+
+extern const uint16_t stage1[];
+extern const uint8_t stage2[];
+} // namespace detail
+
+class Properties {
+  uint8_t bits;
+
+public:
+  explicit Properties(uint8_t b) : bits{b} {}
+
+  GraphemeBreak grapheme_break() const {
+    return static_cast<GraphemeBreak>(bits & detail::break_mask);
+  }
+  bool extended_pictographic() const {
+    return bits & detail::extended_pictographic;
+  }
+  bool wide() const { return bits & detail::wide; }
+  // East Asian Wide or Fullwidth, or presented as emoji by default.
+};
+
+inline Properties properties(uint32_t cp) {
+  using namespace detail;
+  if (cp > max_code_point) {
+    cp = 0xFFFD;
+  }
+  uint32_t block = stage1[cp >> block_shift];
+  return Properties{stage2[block * block_size + (cp & (block_size - 1))]};
+}
+
+uint32_t decode_utf8(const char *&pos, const char *end);
+// Decodes the code point at pos and moves pos past it. An invalid or
+// truncated sequence decodes as U+FFFD, consuming only its valid prefix.
+
+size_t encode_utf8(uint32_t cp, char *out);
+// Writes the 1 to 4 byte encoding of cp to out, returns its length.
+
+bool is_valid_utf8(const char *data, size_t length);
+// True if data is a sequence of complete, well formed UTF-8 sequences.
+
+namespace detail {
+// The validators is_valid_utf8 chooses between, exposed for testing. The
+// SSSE3 one must only be called if has_ssse3(), without SSSE3 support built
+// in it's the scalar one.
+bool has_ssse3();
+bool is_valid_utf8_scalar(const char *data, size_t length);
+bool is_valid_utf8_ssse3(const char *data, size_t length);
+} // namespace detail
+
+void replace_invalid_utf8(const char *data, size_t length, std::string &out);
+// Appends data to out, with each invalid sequence replaced by U+FFFD.
+
+class GraphemeBreaker {
+  // Applies the grapheme cluster boundary rules of UAX #29 to a sequence of
+  // code points, one at a time.
+  GraphemeBreak prev = GraphemeBreak::CONTROL;
+  bool start = true;
+  bool pictographic = false;     // in Extended_Pictographic Extend*
+  bool pictographic_zwj = false; // ... followed by ZWJ
+  bool odd_regional = false;     // an odd number of regional indicators
+
+public:
+  void reset() { *this = GraphemeBreaker{}; }
+
+  bool breaks_before(Properties p);
+  // Returns true if there is a cluster boundary before the code point with
+  // properties p, which then becomes the previous code point.
+};
+
+int cluster_width(const char *cluster, size_t length);
+// The number of cells, 1 or 2, the grapheme cluster is displayed in.
+
+} // namespace unicode
@@ -0,0 +1,115 @@
+#include "unicode.hpp"
+
+#include <gtest/gtest.h>
+#include <cstring>
+#include <string>
+#include <utility>
+
+TEST(Unicode, DecodeInvalid) {
+  // Overlong, surrogate, truncated, out of range.
+  for (std::string s :
+       {"\xC0\xAF", "\xED\xA0\x80", "\xE2\x82", "\xF4\x90"}) {
+    const char *pos = s.data();
+    const char *end = s.data() + s.size();
+
+    EXPECT_EQ(0xFFFDu, unicode::decode_utf8(pos, end));
+    EXPECT_NE(s.data(), pos);
+  }
+
+  std::string euro = "\xE2\x82\xAC";
+  const char *pos = euro.data();
+  EXPECT_EQ(0x20ACu, unicode::decode_utf8(pos, euro.data() + euro.size()));
+  EXPECT_EQ(euro.data() + euro.size(), pos);
+}
+
+TEST(Unicode, ValidUTF8) {
+  // Errors at every offset, to cross the boundaries of vector blocks.
+  const std::string padding = "\xC3\xB7\xE2\x82\xAC\xF0\x9F\x98\x82";
+
+  for (size_t n = 0; n < 40; n++) {
+    std::string prefix;
+    while (prefix.size() < n) {
+      prefix += padding;
+    }
+
+    auto valid = [&](std::string s) {
+      s = prefix + s;
+      return unicode::is_valid_utf8(s.data(), s.size());
+    };
+
+    EXPECT_TRUE(valid(""));
+    EXPECT_TRUE(valid("\xF4\x8F\xBF\xBF"));
+    EXPECT_TRUE(valid("\xEF\xBF\xBD"));
+    EXPECT_FALSE(valid("\x80"));
+    EXPECT_FALSE(valid("\xC1\xBF"));
+    EXPECT_FALSE(valid("\xE0\x9F\xBF"));
+    EXPECT_FALSE(valid("\xED\xA0\x80"));
+    EXPECT_FALSE(valid("\xF0\x8F\xBF\xBF"));
+    EXPECT_FALSE(valid("\xF4\x90\x80\x80"));
+    EXPECT_FALSE(valid("\xF0\x9F\x98"));
+    EXPECT_FALSE(valid("\xC3\xB7\xB7"));
+  }
+}
+
+TEST(Unicode, ValidatorsAgree) {
+  // Each case after n ASCII bytes, so it straddles every offset in a 16 byte
+  // block, and with and without more text after it.
+  const std::pair<std::string, bool> cases[] = {
+      {"\xF4\x8F\xBF\xBF", true},      // U+10FFFF
+      {"\xEF\xBF\xBD", true},          // U+FFFD
+      {"\xED\x9F\xBF", true},          // below the surrogates
+      {"\xF0\x9F\x98", false},         // truncated 4 byte sequences
+      {"\xF0\x9F", false},
+      {"\xF0", false},
+      {"\xE2\x82", false},              // truncated 3 byte
+      {"\xC3", false},                  // truncated 2 byte
+      {"\xED\xA0\x80", false},          // surrogates
+      {"\xED\xBF\xBF", false},
+      {"\xC0\x80", false},              // overlong
+      {"\xC1\xBF", false},
+      {"\xE0\x80\x80", false},
+      {"\xE0\x9F\xBF", false},
+      {"\xF0\x80\x80\x80", false},
+      {"\xF0\x8F\xBF\xBF", false},
+      {"\xF4\x90\x80\x80", false},      // beyond U+10FFFF
+      {"\xF5\x80\x80\x80", false},
+      {"\xFF", false},
+      {"\x80", false},                  // stray continuation
+      {"\xC3\xB7\xB7", false},
+  };
+
+  const bool ssse3 = unicode::detail::has_ssse3();
+
+  for (size_t n = 0; n < 48; n++) {
+    for (const char *suffix : {"", "abc", "0123456789abcdef0123"}) {
+      for (const auto &c : cases) {
+        const std::string s = std::string(n, 'a') + c.first + suffix;
+        SCOPED_TRACE(testing::Message() << "offset " << n << " suffix "
+                                        << std::strlen(suffix));
+
+        EXPECT_EQ(c.second,
+                  unicode::detail::is_valid_utf8_scalar(s.data(), s.size()));
+        if (ssse3) {
+          EXPECT_EQ(c.second,
+                    unicode::detail::is_valid_utf8_ssse3(s.data(), s.size()));
+        }
+        EXPECT_EQ(c.second, unicode::is_valid_utf8(s.data(), s.size()));
+      }
+    }
+  }
+}
+
+TEST(Unicode, ClusterWidth) {
+  auto width = [](std::string s) {
+    return unicode::cluster_width(s.data(), s.size());
+  };
+
+  EXPECT_EQ(1, width("a"));
+  EXPECT_EQ(1, width("e\xcc\x81"));           // e + acute
+  EXPECT_EQ(2, width("\xe4\xb8\xad"));         // CJK ideograph
+  EXPECT_EQ(2, width("\xef\xbc\xa1"));         // fullwidth A
+  EXPECT_EQ(1, width("\xef\xbd\xb1"));         // halfwidth katakana
+  EXPECT_EQ(2, width("\xF0\x9F\x98\x82"));     // emoji presentation
+  EXPECT_EQ(1, width("\xe2\x9d\xa4"));         // heavy heart, text style
+  EXPECT_EQ(2, width("\xe2\x9d\xa4\xef\xb8\x8f")); // ... with VS16
+}
@@ -0,0 +1,160 @@
+#include "unicode.hpp"
+
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Writes unicode_tables.cpp from the Unicode Character Database files
+// GraphemeBreakProperty.txt, emoji-data.txt and EastAsianWidth.txt.
+//
+// usage: unicode-gen <ucd directory> <output file>
+
+namespace {
+
+using namespace unicode;
+
+std::string trim(const std::string &s) {
+  size_t b = s.find_first_not_of(" \t");
+  size_t e = s.find_last_not_of(" \t");
+  return b == std::string::npos ? "" : s.substr(b, e - b + 1);
+}
+
+// Calls f(first, last, value) for each "XXXX..YYYY ; Value # ..." line.
+template <typename F> void read_ucd(const std::string &path, F &&f) {
+  std::ifstream in{path};
+  if (!in) {
+    throw std::runtime_error("Unable to open " + path);
+  }
+
+  std::string line;
+  while (std::getline(in, line)) {
+    line = line.substr(0, line.find('#'));
+    size_t semi = line.find(';');
+    if (semi == std::string::npos) {
+      continue;
+    }
+
+    std::string range = trim(line.substr(0, semi));
+    std::string value = trim(line.substr(semi + 1));
+
+    size_t dots = range.find("..");
+    uint32_t first = std::stoul(range.substr(0, dots), nullptr, 16);
+    uint32_t last = dots == std::string::npos
+                        ? first
+                        : std::stoul(range.substr(dots + 2), nullptr, 16);
+
+    f(first, last, value);
+  }
+}
+
+std::vector<uint8_t> read_properties(const std::string &dir) {
+  std::vector<uint8_t> props(detail::max_code_point + 1, 0);
+
+  auto set = [&](uint32_t first, uint32_t last, uint8_t bits) {
+    for (uint32_t cp = first; cp <= last; cp++) {
+      props[cp] |= bits;
+    }
+  };
+
+  const std::map<std::string, GraphemeBreak> breaks{
+      {"CR", GraphemeBreak::CR},
+      {"LF", GraphemeBreak::LF},
+      {"Control", GraphemeBreak::CONTROL},
+      {"Extend", GraphemeBreak::EXTEND},
+      {"ZWJ", GraphemeBreak::ZWJ},
+      {"Regional_Indicator", GraphemeBreak::REGIONAL_INDICATOR},
+      {"Prepend", GraphemeBreak::PREPEND},
+      {"SpacingMark", GraphemeBreak::SPACING_MARK},
+      {"L", GraphemeBreak::L},
+      {"V", GraphemeBreak::V},
+      {"T", GraphemeBreak::T},
+      {"LV", GraphemeBreak::LV},
+      {"LVT", GraphemeBreak::LVT},
+  };
+
+  read_ucd(dir + "/GraphemeBreakProperty.txt",
+           [&](uint32_t first, uint32_t last, const std::string &value) {
+             auto it = breaks.find(value);
+             if (it == breaks.end()) {
+               throw std::runtime_error("Unknown break property " + value);
+             }
+             set(first, last, static_cast<uint8_t>(it->second));
+           });
+
+  read_ucd(dir + "/emoji-data.txt",
+           [&](uint32_t first, uint32_t last, const std::string &value) {
+             if (value == "Extended_Pictographic") {
+               set(first, last, detail::extended_pictographic);
+             } else if (value == "Emoji_Presentation") {
+               set(first, last, detail::wide);
+             }
+           });
+
+  read_ucd(dir + "/EastAsianWidth.txt",
+           [&](uint32_t first, uint32_t last, const std::string &value) {
+             if (value == "W" || value == "F") {
+               set(first, last, detail::wide);
+             }
+           });
+
+  return props;
+}
+
+void write_array(std::ostream &out, const char *declaration,
+                 const std::vector<unsigned> &values) {
+  out << declaration << " = {";
+  for (size_t i = 0; i < values.size(); i++) {
+    out << (i % 16 == 0 ? "\n    " : " ") << values[i] << ",";
+  }
+  out << "\n};\n";
+}
+} // namespace
+
+int main(int argc, char *argv[]) {
+  if (argc != 3) {
+    std::cerr << "usage: " << argv[0] << " <ucd directory> <output file>\n";
+    return 1;
+  }
+
+  std::vector<uint8_t> props = read_properties(argv[1]);
+
+  // Deduplicate the blocks of properties.
+  std::map<std::vector<uint8_t>, unsigned> blocks;
+  std::vector<unsigned> stage1;
+  std::vector<unsigned> stage2;
+
+  for (size_t begin = 0; begin < props.size(); begin += detail::block_size) {
+    std::vector<uint8_t> block(props.begin() + begin,
+                               props.begin() + begin + detail::block_size);
+
+    auto [it, inserted] =
+        blocks.emplace(block, static_cast<unsigned>(blocks.size()));
+    if (inserted) {
+      stage2.insert(stage2.end(), block.begin(), block.end());
+    }
+    stage1.push_back(it->second);
+  }
+
+  std::ostringstream out;
+  out << "// Generated by unicode-gen from the Unicode Character Database, "
+         "do not edit.\n\n"
+      << "#include \"unicode.hpp\"\n\n"
+      << "namespace unicode {\n"
+      << "namespace detail {\n\n";
+  write_array(out, "const uint16_t stage1[]", stage1);
+  out << "\n";
+  write_array(out, "const uint8_t stage2[]", stage2);
+  out << "\n} // namespace detail\n"
+      << "} // namespace unicode\n";
+
+  std::ofstream file{argv[2]};
+  file << out.str();
+
+  std::cout << "unicode-gen: " << stage1.size() << " + " << stage2.size()
+            << " bytes of tables\n";
+
+  return file ? 0 : 1;
+}
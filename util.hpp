@@ -1,9 +1,30 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
 #include <utility>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
 
 namespace util {
 
+// The index of the lowest set bit of word, which must not be zero.
+inline int lowest_bit(uint64_t word) {
+#if defined(_MSC_VER)
+  unsigned long index;
+  _BitScanForward64(&index, word);
+  return static_cast<int>(index);
+#else
+  return __builtin_ctzll(word);
+#endif
+}
+
 template <typename T> class DirtyTracker {
   T _t;
 
@@ -39,6 +60,151 @@ public:
 };
 
 
+class Base64Decoder {
+  // Decodes base64 a character at a time, so it can be fed straight from a
+  // stream. Padding and characters outside the alphabet are skipped.
+  uint32_t bits = 0;
+  int num_bits = 0;
+
+public:
+  void reset() {
+    bits = 0;
+    num_bits = 0;
+  }
+
+  size_t decode(char c, char *out);
+  // Writes the next byte to out once one is complete, returns the number of
+  // bytes written (0 or 1).
+};
+
+inline size_t Base64Decoder::decode(char c, char *out) {
+  int value;
+  if (c >= 'A' && c <= 'Z')
+    value = c - 'A';
+  else if (c >= 'a' && c <= 'z')
+    value = c - 'a' + 26;
+  else if (c >= '0' && c <= '9')
+    value = c - '0' + 52;
+  else if (c == '+')
+    value = 62;
+  else if (c == '/')
+    value = 63;
+  else
+    return 0;
+
+  bits = (bits << 6) | static_cast<uint32_t>(value);
+  num_bits += 6;
+
+  if (num_bits < 8) {
+    return 0;
+  }
+
+  num_bits -= 8;
+  *out = static_cast<char>((bits >> num_bits) & 0xFF);
+  return 1;
+}
+
+template <typename T> class TripleBuffer {
+  // Hands the latest value from one producer thread to one consumer thread,
+  // without either ever waiting for the other. The producer fills its back
+  // buffer and publishes it, swapping it with the middle buffer. The consumer
+  // swaps its front buffer with the middle one when a new value is there.
+  // Values published faster than they are consumed are dropped, only the
+  // newest is kept.
+  static constexpr uint8_t index_mask = 0x3;
+  static constexpr uint8_t fresh = 0x4;
+
+  std::array<T, 3> buffers{};
+
+  std::atomic<uint8_t> middle{1};
+  uint8_t back = 0;  // producer only
+  uint8_t front = 2; // consumer only
+
+public:
+  T &back_buffer() { return buffers[back]; }
+  // The producer's buffer, to fill before publish.
+
+  void publish() {
+    back = middle.exchange(back | fresh, std::memory_order_acq_rel) &
+           index_mask;
+  }
+
+  bool consumed() const {
+    return !(middle.load(std::memory_order_acquire) & fresh);
+  }
+  // True if the consumer has taken the last published value.
+
+  bool update() {
+    if (consumed()) {
+      return false;
+    }
+    front = middle.exchange(front, std::memory_order_acq_rel) & index_mask;
+    return true;
+  }
+  // Make the newest published value the front buffer, returns false if
+  // there is none newer.
+
+  const T &front_buffer() const { return buffers[front]; }
+};
+
+class Damage {
+  // The rows of a grid changed since the last clear, as a bitset, and the
+  // span of columns changed in each. Marking everything is O(rows).
+  struct Span {
+    int begin;
+    int end;
+  };
+
+  std::vector<uint64_t> bits;
+  std::vector<Span> spans;
+  int num_cols = 0;
+
+public:
+  void resize(int rows, int cols) {
+    bits.assign((rows + 63) / 64, 0);
+    spans.assign(rows, Span{0, 0});
+    num_cols = cols;
+    mark_all();
+  }
+  // Sets the size, everything is damaged.
+
+  void mark(int row, int begin_col, int end_col) {
+    uint64_t &word = bits[row / 64];
+    const uint64_t bit = uint64_t{1} << (row % 64);
+    Span &span = spans[row];
+
+    if (!(word & bit)) {
+      word |= bit;
+      span = Span{begin_col, end_col};
+    } else {
+      span.begin = std::min(span.begin, begin_col);
+      span.end = std::max(span.end, end_col);
+    }
+  }
+
+  void mark_rows(int begin_row, int end_row) {
+    for (int row = begin_row; row < end_row; row++) {
+      mark(row, 0, num_cols);
+    }
+  }
+
+  void mark_all() { mark_rows(0, static_cast<int>(spans.size())); }
+
+  bool dirty(int row) const { return bits[row / 64] >> (row % 64) & 1; }
+
+  template <typename F> void for_each(F f) const {
+    for (size_t w = 0; w < bits.size(); w++) {
+      for (uint64_t word = bits[w]; word != 0; word &= word - 1) {
+        int row = static_cast<int>(w * 64) + lowest_bit(word);
+        f(row, spans[row].begin, spans[row].end);
+      }
+    }
+  }
+  // Calls f(row, begin_col, end_col) for each damaged row, in order.
+
+  void clear() { std::fill(bits.begin(), bits.end(), 0); }
+};
+
 template< typename F>
 class ScopeExit {
 public:
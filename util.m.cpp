@@ -2,6 +2,10 @@
 
 #include <gtest/gtest.h>
 #include <algorithm>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
 
 using namespace ::testing;
 using namespace util;
@@ -72,3 +76,115 @@ TEST(DirtyTracker, Algo) {
 
   ASSERT_EQ(0, num_dirty());
 }
+
+TEST(Base64Decoder, Decode) {
+  auto decode = [](std::string_view in) {
+    Base64Decoder d;
+    std::string out;
+    for (char c : in) {
+      char b;
+      if (d.decode(c, &b)) {
+        out.push_back(b);
+      }
+    }
+    return out;
+  };
+
+  ASSERT_EQ("hello", decode("aGVsbG8="));
+  ASSERT_EQ("hello world", decode("aGVsbG8gd29ybGQ="));
+  ASSERT_EQ("\xff\xfe", decode("//4="));
+  ASSERT_EQ("hello", decode("aGVs\nbG8"));
+  ASSERT_EQ("", decode("?"));
+}
+
+TEST(Damage, Rows) {
+  Damage damage;
+  damage.resize(100, 80);
+
+  int count = 0;
+  damage.for_each([&](int, int begin, int end) {
+    count++;
+    ASSERT_EQ(0, begin);
+    ASSERT_EQ(80, end);
+  });
+  ASSERT_EQ(100, count);
+
+  damage.clear();
+  damage.for_each([&](int, int, int) { FAIL(); });
+
+  damage.mark(70, 10, 11);
+  damage.mark(3, 5, 6);
+  damage.mark(70, 2, 4);
+
+  std::vector<std::array<int, 3>> seen;
+  damage.for_each([&](int row, int begin, int end) {
+    seen.push_back({row, begin, end});
+  });
+
+  ASSERT_EQ(2u, seen.size());
+  ASSERT_EQ((std::array<int, 3>{3, 5, 6}), seen[0]);
+  ASSERT_EQ((std::array<int, 3>{70, 2, 11}), seen[1]);
+  ASSERT_TRUE(damage.dirty(70));
+  ASSERT_FALSE(damage.dirty(71));
+}
+
+TEST(TripleBuffer, Handoff) {
+  TripleBuffer<int> buffer;
+
+  ASSERT_FALSE(buffer.update());
+  ASSERT_TRUE(buffer.consumed());
+
+  buffer.back_buffer() = 1;
+  buffer.publish();
+  buffer.back_buffer() = 2;
+  buffer.publish();
+
+  // Only the newest value is seen.
+  ASSERT_FALSE(buffer.consumed());
+  ASSERT_TRUE(buffer.update());
+  ASSERT_EQ(2, buffer.front_buffer());
+  ASSERT_TRUE(buffer.consumed());
+  ASSERT_FALSE(buffer.update());
+  ASSERT_EQ(2, buffer.front_buffer());
+}
+
+TEST(TripleBuffer, Threads) {
+  TripleBuffer<std::array<int, 64>> buffer;
+
+  constexpr int count = 100000;
+
+  std::thread producer{[&] {
+    for (int i = 1; i <= count; i++) {
+      buffer.back_buffer().fill(i);
+      buffer.publish();
+    }
+  }};
+
+  // Each value seen must be whole and no older than the last.
+  bool whole = true;
+  bool ordered = true;
+
+  int last = 0;
+  while (last != count) {
+    if (buffer.update()) {
+      const auto &value = buffer.front_buffer();
+      whole &= std::all_of(value.begin(), value.end(),
+                           [&](int v) { return v == value[0]; });
+      ordered &= value[0] >= last;
+      last = value[0];
+    }
+  }
+
+  producer.join();
+
+  ASSERT_TRUE(whole);
+  ASSERT_TRUE(ordered);
+}
+
+TEST(LowestBit, EachBit) {
+  for (int bit = 0; bit < 64; bit++) {
+    const uint64_t word = uint64_t{1} << bit;
+    ASSERT_EQ(bit, lowest_bit(word));
+    ASSERT_EQ(bit, lowest_bit(word | word << 1 | uint64_t{1} << 63));
+  }
+}
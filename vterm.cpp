@@ -1,11 +1,14 @@
 #include "vterm.hpp"
 
+#include "unicode.hpp"
+
+#include <algorithm>
+#include <tuple>
+
 namespace app {
 VTerm::VTerm(int _rows, int _cols)
-: window(_rows, _cols)
+: grid(_rows, _cols)
 {
-  cell.fg_col = 0xFFFFFFFF;
-  cell.bg_col = 0x000000FF;
 }
 
 void VTerm::resize(int _rows, int _cols) {
@@ -14,20 +17,31 @@ void VTerm::resize(int _rows, int _cols) {
   }
   rows = _rows;
   cols = _cols;
-  window.resize_term(rows, cols);
-  window.redraw();
+  scroll_row_end = std::min(scroll_row_end, rows);
+
+  // The grid rewraps its contents, and moves the cursor with them.
+  grid.move_cursor(row, col);
+  grid.resize(rows, cols);
+  std::tie(row, col) = grid.cursor();
 }
 
 void VTerm::overwriteglyph(const char *input, size_t len) {
-  cell.glyph.assign(input, len);
-  window.set_cell(row, col, cell);
+  gfx::Glyph glyph = grid.intern(input, len);
+  overwriteglyph(glyph);
+  // Nothing holds it if the cursor was outside the grid.
+  grid.discard(glyph);
+}
+
+void VTerm::overwriteglyph(gfx::Glyph glyph) {
+  cell.glyph = glyph;
+  grid.set_cell(row, col, cell);
 }
 
 void VTerm::start_new_row() {
   // If the next row has put us beyond the scroll region:
   if (row == scroll_row_end) {
     // scroll up and start the last line again.
-    window.scroll(scroll_row_begin, scroll_row_end, gfx::Direction::UP, 1);
+    grid.scroll(scroll_row_begin, scroll_row_end, gfx::Direction::UP, 1);
     row = scroll_row_end-1;
   }
 }
@@ -42,27 +56,66 @@ void VTerm::delete_lines(int num) {
 
 void VTerm::scroll_up(int num) {
   // scroll [row, scroll_row_end) up num times
-  window.scroll(row, scroll_row_end, gfx::Direction::UP, num);
+  grid.scroll(row, scroll_row_end, gfx::Direction::UP, num);
 }
 
 void VTerm::scroll_down(int num) {
   // scroll [row, scroll_row_end) down num times
-  window.scroll(row, scroll_row_end, gfx::Direction::DOWN, num);
+  grid.scroll(row, scroll_row_end, gfx::Direction::DOWN, num);
 }
 
 void VTerm::putglyph(const char *input, size_t len) {
+  gfx::Glyph glyph = grid.intern(input, len);
+  putglyph(glyph, unicode::cluster_width(input, len));
+  // Nothing holds it if the cursor was outside the grid.
+  grid.discard(glyph);
+}
+
+void VTerm::putglyph(gfx::Glyph glyph, int width) {
 
-  // If we are of the rightmost column, we start the next row.
-  if (col >= cols) {
+  // If we are of the rightmost column, or the glyph won't fit, we start the
+  // next row.
+  if (col + width > cols) {
+    grid.set_wrapped(row, true);
     col = 0;
     row++;
 
     start_new_row();
   }
 
-  overwriteglyph(input, len);
+  overwriteglyph(glyph);
 
   col++;
+
+  if (width == 2) {
+    // The glyph covers the next cell too, which is left empty.
+    overwriteglyph(gfx::Glyph::empty());
+
+    col++;
+  }
+}
+
+void VTerm::put_text(const char *input, size_t len) {
+  while (len > 0) {
+    // As putglyph, a full row wraps before the next glyph.
+    if (col >= cols) {
+      grid.set_wrapped(row, true);
+      col = 0;
+      row++;
+
+      start_new_row();
+    }
+
+    int written = grid.put_text(row, col, input, len, cell.style);
+    if (written == 0) {
+      // The cursor is outside the grid.
+      return;
+    }
+
+    col += written;
+    input += written;
+    len -= written;
+  }
 }
 
 void clamp(int &v, int min, int max) {
@@ -104,28 +157,12 @@ void VTerm::curs_backspace() {
   curs_clamp(row, col, rows, cols);
 }
 
-bool &get_attr(gfx::TermCell &cell, gfx::TermCell::Attr attr) {
-  static bool b = false;
-  using Attr = gfx::TermCell::Attr;
-  // clang-format off
-  switch (attr) {
-  case Attr::BOLD:       return cell.bold;
-  case Attr::ITALIC:     return cell.italic;
-  case Attr::OVERLINE:   return cell.overline;
-  case Attr::UNDERLINE:  return cell.underline;
-  case Attr::DUNDERLINE: return cell.dunderline;
-  case Attr::STRIKE:     return cell.strike;
-  case Attr::FEINT:      return cell.feint;
-  case Attr::REVERSE:    return cell.reverse;
-  case Attr::FG: case Attr::BG: default: return b;
-  }
-  // clang-format on
-}
+void VTerm::cell_set_(gfx::Style::Attr attr) { pen.set(attr, true); }
 
-void VTerm::cell_set_(gfx::TermCell::Attr attr) { get_attr(cell, attr) = true; }
-
-void VTerm::cell_reset_(gfx::TermCell::Attr attr) {
-  get_attr(cell, attr) = get_attr(reset, attr);
+void VTerm::cell_reset_(gfx::Style::Attr attr) {
+  pen.set(attr, reset.has(attr));
 }
 
+void VTerm::pen_changed() { cell.style = grid.set_pen(pen); }
+
 } // namespace app
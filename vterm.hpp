@@ -1,6 +1,6 @@
 #pragma once
 
-#include "graphics.hpp"
+#include "grid.hpp"
 
 namespace app {
 class VTerm {
@@ -17,10 +17,12 @@ protected:
   int cols{80};
 
 public:
-  gfx::TermWin window;
+  gfx::Grid grid;
 
   gfx::TermCell cell;
-  gfx::TermCell reset;
+  // Template for written cells, its style is the id of pen.
+  gfx::Style pen;
+  gfx::Style reset;
 
   VTerm(int rows, int cols);
 
@@ -28,15 +30,20 @@ public:
   void resize(int rows, int cols);
 
   void overwriteglyph(const char *input, size_t len);
+  void overwriteglyph(gfx::Glyph glyph);
   void putglyph(const char *input, size_t len);
+  // Write a grapheme cluster at the cursor, taking one or two cells.
+  void put_text(const char *input, size_t len);
+  // Write a run of single byte glyphs, starting at the cursor. Fills a row
+  // at a time, wrapping and scrolling between rows.
 
   void curs_newline();
   void curs_backspace();
   void curs_to_col(int col);
   void curs_to_row(int row);
 
-  void cell_set_(gfx::TermCell::Attr attr);
-  void cell_reset_(gfx::TermCell::Attr attr);
+  void cell_set_(gfx::Style::Attr attr);
+  void cell_reset_(gfx::Style::Attr attr);
 
   template <typename... As> void cell_set(As... as) {
     auto f = [this](auto arg) {
@@ -58,9 +65,8 @@ public:
     (void)X;
   }
 
-  void cell_set_fg(uint32_t);
-  void cell_set_bg(uint32_t);
-  // Set the color of the cell
+  void pen_changed();
+  // Resolve pen to a style id for the cells written next.
 
   void scroll_up(int num=1);
   // Scroll the region up, num times
@@ -79,5 +85,8 @@ public:
 
   void move_rows(int top_row, int bottom_row, int rows_up);
   // Move the given set of rows up or down.
+
+private:
+  void putglyph(gfx::Glyph glyph, int width);
 };
 } // namespace app
@@ -0,0 +1,112 @@
+#include "vterm.hpp"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace testing;
+
+namespace {
+
+// A terminal whose cursor can be looked at.
+struct Term : app::VTerm {
+  Term(int rows, int cols) : VTerm(rows, cols) { resize(rows, cols); }
+
+  void write(std::string text) { put_text(text.data(), text.size()); }
+  std::pair<int, int> cursor() const { return {row, col}; }
+};
+
+// The next frame of the grid.
+gfx::Snapshot frame(Term &term) {
+  gfx::Snapshot snapshot;
+  term.grid.snapshot(snapshot);
+  return snapshot;
+}
+
+// Each row as a string, ASCII as itself, a wide glyph as "#.".
+std::vector<std::string> rows(Term &term) {
+  gfx::Snapshot snapshot = frame(term);
+
+  std::vector<std::string> out(snapshot.rows);
+  for (int i = 0; i < snapshot.rows * snapshot.cols; i++) {
+    gfx::Glyph glyph = snapshot.cells[i].glyph;
+    char c = glyph.is_empty()               ? '.'
+             : glyph.code_point() < 0x80    ? char(glyph.code_point())
+                                            : '#';
+    out[i / snapshot.cols] += c;
+  }
+  return out;
+}
+
+} // namespace
+
+TEST(VTerm, PutTextWraps) {
+  Term term{3, 4};
+  frame(term);
+
+  // The run is split at the margin, each row damaged only where written.
+  term.write("abcdef");
+  EXPECT_EQ(std::make_pair(1, 2), term.cursor());
+  gfx::Snapshot snapshot = frame(term);
+  EXPECT_EQ(0, snapshot.damage[0].begin_col);
+  EXPECT_EQ(4, snapshot.damage[0].end_col);
+  EXPECT_EQ(0, snapshot.damage[1].begin_col);
+  EXPECT_EQ(2, snapshot.damage[1].end_col);
+  EXPECT_NE(snapshot.generation, snapshot.damage[2].frame);
+  EXPECT_THAT(rows(term), ElementsAre("abcd", "ef  ", "    "));
+
+  // The first row is marked as wrapped, so it rejoins when wider.
+  term.resize(3, 8);
+  EXPECT_THAT(rows(term), ElementsAre("abcdef  ", "        ", "        "));
+
+  // Wrapping off the bottom scrolls.
+  term.resize(2, 4);
+  term.write("ghijklmn");
+  EXPECT_THAT(rows(term), ElementsAre("ijkl", "mn  "));
+}
+
+TEST(VTerm, PutTextEndsAtTheMargin) {
+  Term term{2, 4};
+  term.curs_to_row(1);
+  frame(term);
+
+  // Filling the last row leaves the cursor past the margin, nothing scrolls
+  // until the next glyph.
+  term.write("abcd");
+  EXPECT_EQ(std::make_pair(1, 4), term.cursor());
+  gfx::Snapshot snapshot = frame(term);
+  EXPECT_NE(snapshot.generation, snapshot.damage[0].frame);
+  EXPECT_EQ(0, snapshot.damage[1].begin_col);
+  EXPECT_EQ(4, snapshot.damage[1].end_col);
+  EXPECT_THAT(rows(term), ElementsAre("    ", "abcd"));
+
+  term.write("e");
+  EXPECT_EQ(std::make_pair(1, 1), term.cursor());
+  EXPECT_THAT(rows(term), ElementsAre("abcd", "e   "));
+}
+
+TEST(VTerm, PutTextOverWideGlyphs) {
+  Term term{1, 6};
+  term.putglyph("中", 3);
+  term.putglyph("中", 3);
+  term.putglyph("中", 3);
+  EXPECT_THAT(rows(term), ElementsAre("#.#.#."));
+
+  term.curs_to_col(1);
+  term.write("xy");
+  EXPECT_THAT(rows(term), ElementsAre(" xy #."));
+}
+
+TEST(VTerm, GlyphOutsideTheGridIsFreed) {
+  Term term{1, 4};
+  term.write("abcd");
+
+  // The cursor is past the margin, so the cluster isn't written anywhere
+  // and its entry is free for the next.
+  gfx::Glyph dropped = term.grid.intern("e\xcc\x81", 3);
+  term.overwriteglyph("e\xcc\x81", 3);
+  EXPECT_EQ(std::vector<std::string>{"abcd"}, rows(term));
+  EXPECT_EQ(dropped.index(), term.grid.intern("a\xcc\x81", 3).index());
+}